@@ -23,18 +23,25 @@
 
 #include "swarm.h"
 #include "db.h"
+#include "hashtable.h"
 #include "qgram.h"
 #include "nw.h"
 #include "scan.h"
+#include "segindex.h"
+#include "variants.h"
+#include "utils/chunk_scheduler.h"
 #include "utils/cigar.h"
-#include "utils/qgram_threadinfo.h"
 #include "utils/progress.h"
 #include "utils/search_data.h"
 #include "utils/seqinfo.h"
 #include "utils/score_matrix.h"
-#include <algorithm>  // std::min(), std::reverse()
+#include "utils/threads.h"
+#include "utils/union_find.h"
+#include <algorithm>  // std::min(), std::reverse(), std::sort(), std::binary_search()
+#include <atomic>
 #include <cassert>
 #include <cinttypes>  // macros PRIu64 and PRId64
+#include <cstddef>  // std::ptrdiff_t
 #include <cstdint>  // int64_t, uint64_t
 #include <cstdio>  // fputc(), fflush
 #include <cstdlib>  // qsort()
@@ -65,19 +72,15 @@ constexpr char PRId64[] = "ld";
 static uint64_t count_comparisons_8;
 static uint64_t count_comparisons_16;
 
-static uint64_t targetcount;
-
 struct ampliconinfo_s
 {
   unsigned int ampliconid;
-  unsigned int diffestimate; /* lower bound estimate of dist from initial seed */
   unsigned int swarmid;
   unsigned int generation;
   unsigned int radius; /* actual diff from initial seed */
 };
 
 static uint64_t swarmed;
-static uint64_t seeded;
 
 struct swarminfo_t
 {
@@ -235,373 +238,769 @@ auto write_swarms_mothur_format(const uint64_t amplicons,
 
   std::fputc('\n', parameters.outfile);
 }
+/*
+  Two amplicons can only end up in the same swarm if they are joined
+  by a chain of possible links: pairs of amplicons that share a
+  segment (see segindex.h) and pass the q-gram filter. When several
+  threads are used, a first pass splits the amplicons into the
+  connected components of possible links. Each component is then
+  clustered on its own, with the same swarms as when all amplicons
+  are clustered at once. Components holding a large share of the
+  amplicons are clustered one at a time with all threads, the others
+  concurrently, one per thread. Swarms are output in the order of
+  their seeds, as if they had been built one after the other.
+
+  The subseeds of a generation are evaluated against the pool as it
+  is when the generation starts, concurrently (one per thread) in a
+  large component. Their targets are then claimed in subseed order,
+  skipping the ones claimed by a previous subseed of the generation:
+  the pool only differs by these claims, so swarms are the same as
+  when subseeds are processed one at a time. A generation of one
+  subseed is evaluated with all threads instead: each screens a
+  chunk of its candidates (q-gram filter) and aligns the ones passing
+  the filter in its own channels, a single dispatch per subseed.
+*/
 
+/* the alignments of the subseeds evaluated by a thread are queued
+   and made in batches, a (subseed, target) pair per channel, rather
+   than a subseed at a time with most channels idle */
+constexpr auto pairs_per_batch = 512ULL;
+/* subseeds with fewer candidates are screened by a single thread, and
+   screening threads align their targets a batch at a time */
+constexpr auto shared_candidates = 256ULL;
+constexpr auto targets_per_batch = 64ULL;
 
-auto algo_run(struct Parameters const & parameters,
-              std::vector<struct seqinfo_s> & seqindex_v) -> void
+struct subseed_targets_s
 {
-  static constexpr auto uint8_max = std::numeric_limits<uint8_t>::max();
-  const auto score_matrix_63 = create_score_matrix<int64_t>(parameters.penalty_mismatch);
+  std::vector<uint64_t> targets;  /* candidates, by id */
+  std::vector<uint64_t> diffs;  /* by target, above the threshold if filtered out */
+};
 
-  std::vector<struct Search_data> search_data_v(static_cast<uint64_t>(parameters.opt_threads));
-  search_begin(search_data_v);
-  /* start threads */
-  assert(parameters.opt_threads <= std::numeric_limits<int>::max());
-  const std::unique_ptr<ThreadRunner> search_threads (new ThreadRunner(static_cast<int>(parameters.opt_threads), search_worker_core));
+struct swarm_link_s
+{
+  /* target joined the swarm from subseed */
+  unsigned int subseed;
+  unsigned int target;
+  unsigned int diff;
+  unsigned int generation;
+};
 
-  count_comparisons_8 = 0;
-  count_comparisons_16 = 0;
+struct subseed_work_s;
 
-  uint64_t largestswarm {0};
-  uint64_t maxgenerations {0};
+struct swarm_s
+{
+  struct subseed_work_s const * work {nullptr};  /* that built it */
+  uint64_t first_member {0};  /* in work->members_v */
+  uint64_t first_link {0};  /* in work->links_v */
+  uint64_t size {0};
+  uint64_t amplicons_copies {0};
+  uint64_t singletons {0};
+  uint64_t maxgen {1};  // a cluster can't contain less than 1 generation
+  uint64_t maxradius {0};
+  unsigned int seed {0};
+};
 
-  const auto amplicons = db_getsequencecount();
-  const uint64_t longestamplicon = db_getlongestsequence();
+struct subseed_work_s
+{
+  struct Search_data * search_data {nullptr};
+  struct segindex_work_s lookup;
+  std::vector<uint64_t> candidates;
+  std::vector<uint64_t> qgramdiffs;
+  std::vector<uint64_t> neighbours;
+  std::vector<uint64_t> scores;
+  std::vector<uint64_t> searchdiffs;
+  std::vector<uint64_t> alignlengths;
+  std::vector<struct var_s> variant_list;
+  /* queued alignments, and where their diffs go */
+  std::vector<uint64_t> pair_queries;
+  std::vector<uint64_t> pair_targets;
+  std::vector<uint64_t *> pair_diffs;
+  uint64_t comparisons {0};
+  std::vector<struct subseed_targets_s> targets_v;  /* by subseed */
+  std::vector<struct ampliconinfo_s> next_generation_v;
+  /* swarms built by this thread; members are ordered by swarm, then
+     by generation, then by amplicon id, links in claim order */
+  std::vector<struct swarm_s> swarms_v;
+  std::vector<struct ampliconinfo_s> members_v;
+  std::vector<struct swarm_link_s> links_v;
+};
 
-  db_qgrams_init(parameters, seqindex_v);
+struct component_s
+{
+  uint64_t first {0};  /* in component_members_v */
+  uint64_t size {0};
+};
 
-  std::vector<struct thread_info_s> thread_info_v;
-  qgram_diff_init(thread_info_v);
+struct clustering_s
+{
+  struct segindex_s * index {nullptr};
+  std::vector<unsigned char> * swarmed_v {nullptr};
+  std::vector<unsigned int> const * component_v {nullptr};  /* by amplicon */
+  std::vector<unsigned int> const * component_members_v {nullptr};  /* by component, then id */
+  std::vector<struct component_s> const * components_v {nullptr};  /* clustered concurrently */
+  UnionFind * components {nullptr};  /* while linking */
+  ChunkScheduler * scheduler {nullptr};
+  std::vector<struct subseed_work_s> work_v;  /* by thread */
+  std::atomic<uint64_t> swarmed_count {0};
+  uint64_t differences {0};
+  int bits {0};
+  bool no_cluster_breaking {false};
+  bool align_substitutions {false};  /* two gaps may cost less than a mismatch */
+  /* generation evaluated by all threads */
+  struct ampliconinfo_s const * subseeds {nullptr};
+  uint64_t size {0};
+  std::atomic<uint64_t> next {0};
+  std::vector<struct subseed_targets_s> * targets_v {nullptr};
+  /* subseed screened by all threads */
+  uint64_t screened {0};
+  std::vector<uint64_t> const * neighbours {nullptr};
+  struct subseed_targets_s * screened_targets {nullptr};
+};
 
-  std::vector<struct ampliconinfo_s> amps_v(amplicons);
-  std::vector<uint64_t> targetampliconids(amplicons);
-  std::vector<uint64_t> targetindices(amplicons);
-  std::vector<uint64_t> scores_v(amplicons);
-  std::vector<uint64_t> diffs_v(amplicons);
-  std::vector<uint64_t> alignlengths(amplicons);
-  std::vector<uint64_t> qgramamps_v(amplicons);
-  std::vector<uint64_t> qgramdiffs_v(amplicons);
-  std::vector<uint64_t> qgramindices_v(amplicons);
-  std::vector<uint64_t> hits(amplicons);
+static struct clustering_s * clustering;
 
-  auto const diff_saturation
-    = static_cast<uint64_t>(std::min(uint8_max / parameters.penalty_mismatch,
-                                     uint8_max / (parameters.penalty_gapopen +
-                                                  parameters.penalty_gapextend)));
 
-  std::vector<unsigned char> directions;
-  std::vector<uint64_t> hearray;
-  std::vector<char> raw_alignment;
-  std::string cigar_string;
-  raw_alignment.reserve(2 * longestamplicon);
-  cigar_string.reserve(2 * longestamplicon);
-
-  if (parameters.uclustfile != nullptr)
+auto link_worker(int64_t const nth_thread) -> void
+{
+  /* a possible link is checked from its first amplicon, unless both
+     amplicons are already known to be connected */
+  auto & work = clustering->work_v[static_cast<uint64_t>(nth_thread)];
+  auto & components = *clustering->components;
+  auto & candidates = work.candidates;
+  uint64_t first {0};
+  uint64_t count {0};
+  while (clustering->scheduler->get_chunk(first, count))
     {
-      directions.resize(longestamplicon * longestamplicon);
-      hearray.resize(2 * longestamplicon);
+      for(auto amp = first; amp < first + count; ++amp)
+        {
+          candidates.clear();
+          segindex_lookup(*clustering->index, amp, work.lookup, candidates);
+          const auto root = components.find(static_cast<unsigned int>(amp));
+          candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                          [&components, amp, root](uint64_t const target) -> bool {
+                                            return (target <= amp) or
+                                              (components.find(static_cast<unsigned int>(target)) == root);
+                                          }),
+                           candidates.end());
+          std::sort(candidates.begin(), candidates.end());
+
+          work.qgramdiffs.resize(candidates.size());
+          qgram_diff_list(amp, candidates.size(), candidates.data(), work.qgramdiffs.data());
+          for(auto i = 0ULL; i < candidates.size(); ++i) {
+            if (work.qgramdiffs[i] <= clustering->differences) {
+              components.unite(static_cast<unsigned int>(amp),
+                               static_cast<unsigned int>(candidates[i]));
+            }
+          }
+        }
+      const auto done = clustering->scheduler->add_done(count);
+      if (nth_thread == 0) {
+        progress_update(done);
+      }
     }
+}
 
-  /* set ampliconid for all */
-  for(auto i = 0U; i < amplicons; ++i) {
-    amps_v[i].ampliconid = i;
-  }
 
-  /* always search in 8 bit mode unless resolution is very high */
-  static constexpr auto bit_mode_8 = 8;
-  static constexpr auto bit_mode_16 = 16;
-  auto bits = bit_mode_8;
+auto find_components(struct Parameters const & parameters,
+                     uint64_t const amplicons,
+                     std::vector<unsigned int> & component_v,
+                     std::vector<unsigned int> & component_members_v,
+                     std::vector<struct component_s> & large_components_v,
+                     std::vector<struct component_s> & small_components_v) -> void
+{
+  static constexpr uint64_t link_chunk_max {256};
+  const auto threads = static_cast<uint64_t>(parameters.opt_threads);
+
+  /* the root of a component is its first amplicon */
+  UnionFind components(amplicons);
+
+  progress_init("Linking:          ", amplicons);
+  ChunkScheduler scheduler(amplicons, threads, 1, link_chunk_max);
+  clustering->components = &components;
+  clustering->scheduler = &scheduler;
+  thread_pool->run(link_worker);
+  clustering->components = nullptr;
+  clustering->scheduler = nullptr;
+  progress_done(parameters);
 
-  if (static_cast<uint64_t>(parameters.opt_differences) > diff_saturation) {
-    bits = bit_mode_16;
+  /* components are numbered by their first amplicon, and their
+     members are listed by increasing id */
+  std::vector<unsigned int> next_member_v(amplicons);
+  for(auto amp = 0U; amp < amplicons; ++amp) {
+    component_v[amp] = components.find(amp);
+    ++next_member_v[component_v[amp]];
   }
 
-#ifdef __aarch64__
-#if !defined(DEBUG) || !defined(COVERAGE)
-  /* always use 16-bit version on aarch64 because it is faster */
-  bits = bit_mode_16;
-#endif
-#endif
+  uint64_t first {0};
+  for(auto amp = 0U; amp < amplicons; ++amp)
+    {
+      if (component_v[amp] != amp) {
+        continue;
+      }
+      struct component_s component {};
+      component.first = first;
+      component.size = next_member_v[amp];
+      if (component.size * threads > amplicons) {
+        large_components_v.push_back(component);
+      }
+      else {
+        small_components_v.push_back(component);
+      }
+      next_member_v[amp] = static_cast<unsigned int>(first);
+      first += component.size;
+    }
 
-  seeded = 0;
-  swarmed = 0;
+  for(auto amp = 0U; amp < amplicons; ++amp) {
+    auto & next_member = next_member_v[component_v[amp]];
+    component_members_v[next_member] = amp;
+    ++next_member;
+  }
 
-  auto swarmid = 0U;
+  /* largest components first, to balance the threads */
+  std::stable_sort(small_components_v.begin(), small_components_v.end(),
+                   [](struct component_s const & lhs,
+                      struct component_s const & rhs) -> bool {
+                     return lhs.size > rhs.size;
+                   });
+}
 
-  progress_init("Clustering:       ", amplicons);
-  while (seeded < amplicons)
+
+auto find_neighbours(struct subseed_work_s & work,
+                     uint64_t const subseed) -> void
+{
+  /* microvariants of the subseed, sorted by id, are one difference
+     away (no alignment can do better); substitutions only when a
+     mismatch costs less than a gap in each sequence, otherwise they
+     are aligned like other targets */
+  auto * subseed_sequence = db_getsequence(subseed);
+  const auto subseed_seqlen = db_getsequencelen(subseed);
+  const auto variant_count = generate_variants(subseed_sequence, subseed_seqlen,
+                                               db_gethash(subseed), work.variant_list);
+  work.neighbours.clear();
+  for(auto i = 0U; i < variant_count; ++i)
     {
+      auto & var = work.variant_list[i];
+      if ((var.type == Variant_type::substitution) and clustering->align_substitutions) {
+        continue;
+      }
+      auto index = hash_getindex(var.hash);
+      while (hash_is_occupied(index))
+        {
+          if (hash_compare_value(index, var.hash))
+            {
+              const auto amp = hash_get_data(index);
+              if (check_variant(subseed_sequence, subseed_seqlen, var,
+                                db_getsequence(amp), db_getsequencelen(amp))) {
+                work.neighbours.push_back(amp);
+              }
+            }
+          index = hash_getnextindex(index);
+        }
+    }
+  std::sort(work.neighbours.begin(), work.neighbours.end());
+}
 
-      /* process each initial seed */
 
-      ++swarmid;
+auto queue_alignments(struct subseed_work_s & work,
+                      uint64_t const subseed,
+                      std::vector<uint64_t> const & neighbours,
+                      struct subseed_targets_s & result,
+                      uint64_t const first,
+                      uint64_t const count) -> void
+{
+  /* targets [first, first + count) passing the q-gram filter are
+     microvariants of the subseed, or are queued for alignment */
+  for(auto i = first; i < first + count; ++i) {
+    if (result.diffs[i] > clustering->differences) {
+      continue;
+    }
+    if (std::binary_search(neighbours.cbegin(), neighbours.cend(), result.targets[i])) {
+      result.diffs[i] = 1;
+    }
+    else {
+      work.pair_queries.push_back(subseed);
+      work.pair_targets.push_back(result.targets[i]);
+      work.pair_diffs.push_back(&result.diffs[i]);
+    }
+  }
+}
 
-      uint64_t swarmsize {0};
-      uint64_t amplicons_copies {0};
-      uint64_t singletons {0};
-      uint64_t hitcount {0};
-      uint64_t maxradius {0};
-      uint64_t maxgen {1};  // a cluster can't contain less than 1 generation
-      uint64_t seedindex {0};
 
-      seedindex = seeded;
-      ++seeded;
+auto align_pairs(struct subseed_work_s & work,
+                 bool const one_subseed) -> void
+{
+  /* align the queued (subseed, target) pairs at once, a pair per
+     channel (or a target per channel when they share their subseed),
+     and complete the diffs of their subseeds */
+  const auto pair_count = work.pair_targets.size();
+  if (pair_count == 0) {
+    return;
+  }
+  work.scores.resize(pair_count);
+  work.searchdiffs.resize(pair_count);
+  work.alignlengths.resize(pair_count);
+  if (one_subseed) {
+    search_list(*work.search_data, work.pair_queries.front(), pair_count,
+                work.pair_targets.data(), work.scores.data(), work.searchdiffs.data(),
+                work.alignlengths.data(), clustering->bits);
+  }
+  else {
+    search_pairs(*work.search_data, pair_count, work.pair_queries.data(),
+                 work.pair_targets.data(), work.scores.data(), work.searchdiffs.data(),
+                 work.alignlengths.data(), clustering->bits);
+  }
 
-      amps_v[seedindex].swarmid = swarmid;
-      amps_v[seedindex].generation = 0;
-      amps_v[seedindex].radius = 0;
+  for(auto i = 0ULL; i < pair_count; ++i) {
+    *work.pair_diffs[i] = work.searchdiffs[i];
+  }
+  work.comparisons += pair_count;
+  work.pair_queries.clear();
+  work.pair_targets.clear();
+  work.pair_diffs.clear();
+}
 
-      const uint64_t seedampliconid = amps_v[seedindex].ampliconid;
-      hits[hitcount] = seedampliconid;
-      ++hitcount;
 
-      auto abundance = db_getabundance(seedampliconid);
-      amplicons_copies += abundance;
-      if (abundance == 1) {
-        ++singletons;
+auto screening_worker(int64_t const nth_thread) -> void
+{
+  /* a chunk of candidates at a time: q-gram filter, then alignment
+     of the targets passing it in this thread's channels */
+  auto & work = clustering->work_v[static_cast<uint64_t>(nth_thread)];
+  const auto subseed = clustering->screened;
+  auto & result = *clustering->screened_targets;
+  uint64_t first {0};
+  uint64_t count {0};
+  while (clustering->scheduler->get_chunk(first, count))
+    {
+      qgram_diff_list(subseed, count, &result.targets[first], &result.diffs[first]);
+      queue_alignments(work, subseed, *clustering->neighbours, result, first, count);
+      if (work.pair_targets.size() >= targets_per_batch) {
+        align_pairs(work, true);
       }
+    }
+  align_pairs(work, true);
+}
+
 
-      swarmsize = 1;
-      ++swarmed;
+auto evaluate_subseed(struct subseed_work_s & work,
+                      uint64_t const subseed,
+                      struct subseed_targets_s & result,
+                      bool const all_threads) -> void
+{
+  /* unswarmed amplicons of the subseed's component sharing a
+     segment with it, that it may link to, sorted by id (amplicons
+     of other components are left alone, another thread may be
+     swarming them) */
+  auto & candidates = result.targets;
+  candidates.clear();
+  segindex_lookup(*clustering->index, subseed, work.lookup, candidates);
+  auto const & component_v = *clustering->component_v;
+  auto const & swarmed_v = *clustering->swarmed_v;
+  const auto component = component_v[subseed];
+  const auto abundance = db_getabundance(subseed);
+  const auto no_cluster_breaking = clustering->no_cluster_breaking;
+  candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                  [&component_v, &swarmed_v, component, abundance,
+                                   no_cluster_breaking](uint64_t const amp) -> bool {
+                                    return (component_v[amp] != component) or
+                                      (swarmed_v[amp] != 0) or
+                                      ((not no_cluster_breaking) and
+                                       (db_getabundance(amp) > abundance));
+                                  }),
+                   candidates.end());
+  std::sort(candidates.begin(), candidates.end());
+  result.diffs.resize(candidates.size());
+
+  if (all_threads and (candidates.size() >= shared_candidates))
+    {
+      /* screened and aligned by all threads at once */
+      static constexpr uint64_t screening_chunk_max {64};
+      find_neighbours(work, subseed);
+      ChunkScheduler scheduler(candidates.size(), clustering->work_v.size(),
+                               1, screening_chunk_max);
+      clustering->scheduler = &scheduler;
+      clustering->screened = subseed;
+      clustering->neighbours = &work.neighbours;
+      clustering->screened_targets = &result;
+      thread_pool->run(screening_worker);
+      clustering->scheduler = nullptr;
+      clustering->neighbours = nullptr;
+      clustering->screened_targets = nullptr;
+      return;
+    }
 
+  /* targets passing the q-gram filter are queued for alignment,
+     along with the ones of other subseeds (see align_pairs()) */
+  qgram_diff_list(subseed, candidates.size(), candidates.data(), result.diffs.data());
+  const auto differences = clustering->differences;
+  if (std::none_of(result.diffs.cbegin(), result.diffs.cend(),
+                   [differences](uint64_t const diff) -> bool {
+                     return diff <= differences;
+                   })) {
+    return;
+  }
+  find_neighbours(work, subseed);
+  queue_alignments(work, subseed, work.neighbours, result, 0, candidates.size());
+}
 
-      /* find diff estimates between seed and each amplicon in pool */
 
-      targetcount = 0;
+auto generation_worker(int64_t const nth_thread) -> void
+{
+  auto & work = clustering->work_v[static_cast<uint64_t>(nth_thread)];
+  while (true)
+    {
+      const auto i = clustering->next.fetch_add(1);
+      if (i >= clustering->size) {
+        break;
+      }
+      evaluate_subseed(work, clustering->subseeds[i].ampliconid,
+                       (*clustering->targets_v)[i], false);
+      if (work.pair_targets.size() >= pairs_per_batch) {
+        align_pairs(work, false);
+      }
+    }
+  align_pairs(work, false);
+}
 
-      uint64_t listlen {0};
 
-      for(auto i = 0ULL; i < amplicons - swarmed; ++i)
-        {
-          const auto ampid = amps_v[swarmed + i].ampliconid;
-          if ((parameters.opt_no_cluster_breaking) or (db_getabundance(ampid) <= abundance))
-            {
-              qgramamps_v[i] = ampid;
-              ++listlen;
-            }
-        }
+auto cluster_component(struct subseed_work_s & work,
+                       struct component_s const & component,
+                       bool const all_threads,
+                       bool const report_progress) -> void
+{
+  auto & swarmed_v = *clustering->swarmed_v;
+  auto const * members = &(*clustering->component_members_v)[component.first];
+  const auto differences = clustering->differences;
+  auto unswarmed = component.size;
+  auto next_seed = 0ULL;  /* no member before next_seed is unswarmed */
 
-      qgram_diff_fast(seedampliconid, listlen, qgramamps_v.data(), qgramdiffs_v.data(), thread_info_v);
+  while (unswarmed > 0)
+    {
+      /* the initial seed is the first unswarmed member, it forms
+         generation 0 */
+      while (swarmed_v[members[next_seed]] != 0) {
+        ++next_seed;
+      }
 
+      struct swarm_s swarm {};
+      swarm.work = &work;
+      swarm.seed = members[next_seed];
+      swarm.first_member = work.members_v.size();
+      swarm.first_link = work.links_v.size();
+
+      struct ampliconinfo_s seedinfo {};
+      seedinfo.ampliconid = swarm.seed;
+      work.members_v.push_back(seedinfo);
+      swarmed_v[swarm.seed] = 1;
+      segindex_remove(*clustering->index, swarm.seed);
+      --unswarmed;
+
+      auto abundance = db_getabundance(swarm.seed);
+      swarm.amplicons_copies += abundance;
+      if (abundance == 1) {
+        ++swarm.singletons;
+      }
+      swarm.size = 1;
 
-      for(auto i = 0ULL; i < listlen; ++i)
+      auto seeded = swarm.first_member;
+      while ((seeded < work.members_v.size()) and (unswarmed > 0))
         {
-          const auto poolampliconid = qgramamps_v[i];
-          const auto diff = qgramdiffs_v[i];
-          assert(diff <= std::numeric_limits<unsigned int>::max());
-          amps_v[swarmed + i].diffestimate = static_cast<unsigned int>(diff);
-          if (diff <= static_cast<uint64_t>(parameters.opt_differences))
-            {
-              targetindices[targetcount] = swarmed + i;
-              targetampliconids[targetcount] = poolampliconid;
-              ++targetcount;
-            }
-        }
 
-      if (targetcount > 0)
-        {
-          search_do(seedampliconid, targetcount, targetampliconids.data(),
-                    scores_v.data(), diffs_v.data(), alignlengths.data(), bits, search_threads.get());
+          /* evaluate the subseeds of the current generation */
 
-          if (bits == bit_mode_8) {
-            count_comparisons_8 += targetcount;
+          const auto generation_size = work.members_v.size() - seeded;
+          if (work.targets_v.size() < generation_size) {
+            work.targets_v.resize(generation_size);
+          }
+
+          if (all_threads and (generation_size > 1)) {
+            clustering->subseeds = &work.members_v[seeded];
+            clustering->size = generation_size;
+            clustering->next = 0;
+            clustering->targets_v = &work.targets_v;
+            thread_pool->run(generation_worker);
           }
           else {
-            count_comparisons_16 += targetcount;
+            for(auto i = 0ULL; i < generation_size; ++i) {
+              evaluate_subseed(work, work.members_v[seeded + i].ampliconid,
+                               work.targets_v[i], all_threads);
+              if (work.pair_targets.size() >= pairs_per_batch) {
+                align_pairs(work, false);
+              }
+            }
+            align_pairs(work, false);
           }
 
-          for(auto target_id = 0ULL; target_id < targetcount; ++target_id)
+          /* claim their targets, one subseed at a time */
+
+          for(auto subseed_id = 0ULL; subseed_id < generation_size; ++subseed_id)
             {
-              const auto diff = diffs_v[target_id];
+              const auto subseed = work.members_v[seeded];
+              auto const & subseed_targets = work.targets_v[subseed_id];
 
-              if (diff <= static_cast<uint64_t>(parameters.opt_differences))
-                {
-                  const auto target = targetindices[target_id];
+              ++seeded;
 
-                  /* move the 'target' to the position ('swarmed')
-                     of the first unswarmed amplicon in the pool */
+              for(auto target_id = 0ULL; target_id < subseed_targets.targets.size(); ++target_id)
+                {
+                  const auto poolampliconid = subseed_targets.targets[target_id];
+                  const auto diff = subseed_targets.diffs[target_id];
 
-                  if (swarmed < target)
+                  if ((diff <= differences) and (swarmed_v[poolampliconid] == 0))
                     {
-                      auto const temp = amps_v[target];  // refactoring: static?
-                      for(auto j = target; j > swarmed; --j)
-                        {
-                          amps_v[j] = amps_v[j - 1];
-                        }
-                      amps_v[swarmed] = temp;
+                      /* the target joins the next generation, which
+                         is appended to the swarm once this generation
+                         is processed */
+
+                      struct ampliconinfo_s hit {};
+                      hit.ampliconid = static_cast<unsigned int>(poolampliconid);
+                      assert(subseed.generation + 1ULL <= std::numeric_limits<unsigned int>::max());
+                      hit.generation = subseed.generation + 1;
+                      swarm.maxgen = std::max<uint64_t>(swarm.maxgen, hit.generation);
+                      assert(subseed.radius + diff <= std::numeric_limits<unsigned int>::max());
+                      hit.radius = static_cast<unsigned int>(subseed.radius + diff);
+                      swarm.maxradius = std::max<uint64_t>(hit.radius, swarm.maxradius);
+                      work.next_generation_v.push_back(hit);
+
+                      swarmed_v[poolampliconid] = 1;
+                      segindex_remove(*clustering->index, poolampliconid);
+                      --unswarmed;
+
+                      struct swarm_link_s link {};
+                      link.subseed = subseed.ampliconid;
+                      link.target = hit.ampliconid;
+                      link.diff = static_cast<unsigned int>(diff);
+                      link.generation = hit.generation;
+                      work.links_v.push_back(link);
+
+                      abundance = db_getabundance(poolampliconid);
+                      swarm.amplicons_copies += abundance;
+                      if (abundance == 1) {
+                        ++swarm.singletons;
+                      }
+
+                      ++swarm.size;
                     }
+                }
+            }
 
-                  amps_v[swarmed].swarmid = swarmid;
-                  amps_v[swarmed].generation = 1;
-                  assert(diff <= std::numeric_limits<unsigned int>::max());
-                  amps_v[swarmed].radius = static_cast<unsigned int>(diff);
-                  maxradius = std::max(diff, maxradius);
+          /* append the next generation, ordered by amplicon id */
+          std::sort(work.next_generation_v.begin(), work.next_generation_v.end(),
+                    [](struct ampliconinfo_s const & lhs,
+                       struct ampliconinfo_s const & rhs) -> bool {
+                      return lhs.ampliconid < rhs.ampliconid;
+                    });
+          work.members_v.insert(work.members_v.end(),
+                                work.next_generation_v.cbegin(),
+                                work.next_generation_v.cend());
+          work.next_generation_v.clear();
+        }
 
-                  const auto poolampliconid = amps_v[swarmed].ampliconid;
-                  hits[hitcount] = poolampliconid;
-                  ++hitcount;
+      work.swarms_v.push_back(swarm);
 
-                  if (not parameters.opt_internal_structure.empty())
-                    {
-                      fprint_id_noabundance(parameters.internal_structure_file,
-                                            seedampliconid, parameters.opt_usearch_abundance);
-                      std::fprintf(parameters.internal_structure_file, "\t");
-                      fprint_id_noabundance(parameters.internal_structure_file,
-                                            poolampliconid, parameters.opt_usearch_abundance);
-                      std::fprintf(parameters.internal_structure_file, "\t%" PRIu64, diff);
-                      std::fprintf(parameters.internal_structure_file,
-                              "\t%u\t1",
-                              swarmid);
-                      std::fprintf(parameters.internal_structure_file, "\n");
-                    }
+      const auto done = clustering->swarmed_count.fetch_add(swarm.size) + swarm.size;
+      if (report_progress) {
+        progress_update(done);
+      }
+    }
+}
 
-                  abundance = db_getabundance(poolampliconid);
-                  amplicons_copies += abundance;
-                  if (abundance == 1) {
-                    ++singletons;
-                  }
 
-                  ++swarmsize;
+auto component_worker(int64_t const nth_thread) -> void
+{
+  auto & work = clustering->work_v[static_cast<uint64_t>(nth_thread)];
+  uint64_t first {0};
+  uint64_t count {0};
+  while (clustering->scheduler->get_chunk(first, count))
+    {
+      for(auto i = first; i < first + count; ++i) {
+        cluster_component(work, (*clustering->components_v)[i], false, nth_thread == 0);
+      }
+    }
+}
 
-                  ++swarmed;
-                }
-            }
 
+auto algo_run(struct Parameters const & parameters,
+              std::vector<struct seqinfo_s> & seqindex_v) -> void
+{
+  static constexpr auto uint8_max = std::numeric_limits<uint8_t>::max();
+  const auto score_matrix_63 = create_score_matrix<int64_t>(parameters.penalty_mismatch);
 
-          while (seeded < swarmed)
-            {
+  std::vector<struct Search_data> search_data_v(static_cast<uint64_t>(parameters.opt_threads));
+  search_begin(search_data_v);
 
-              /* process each subseed */
+  count_comparisons_8 = 0;
+  count_comparisons_16 = 0;
 
-              auto subseedampliconid = 0U;
-              auto subseedradius = 0U;
+  uint64_t largestswarm {0};
+  uint64_t maxgenerations {0};
 
-              uint64_t subseedindex {0};
-              uint64_t subseedgeneration {0};
-              uint64_t subseedabundance {0};
+  const auto amplicons = db_getsequencecount();
+  const uint64_t longestamplicon = db_getlongestsequence();
 
-              subseedindex = seeded;
-              subseedampliconid = amps_v[subseedindex].ampliconid;
-              subseedradius = amps_v[subseedindex].radius;
-              subseedgeneration = amps_v[subseedindex].generation;
-              subseedabundance = db_getabundance(subseedampliconid);
+  db_qgrams_init(parameters, seqindex_v);
 
-              ++seeded;
+  std::vector<struct ampliconinfo_s> amps_v;
+  std::vector<unsigned char> swarmed_v(amplicons);  /* by amplicon id */
+  struct segindex_s segment_index;
 
-              targetcount = 0;
+  auto const diff_saturation
+    = static_cast<uint64_t>(std::min(uint8_max / parameters.penalty_mismatch,
+                                     uint8_max / (parameters.penalty_gapopen +
+                                                  parameters.penalty_gapextend)));
 
-              uint64_t subseedlistlen {0};
-              for(auto i = swarmed; i < amplicons; ++i)
-                {
-                  const uint64_t targetampliconid = amps_v[i].ampliconid;
-                  if ((amps_v[i].diffestimate <=
-                       subseedradius + parameters.opt_differences) and
-                      ((parameters.opt_no_cluster_breaking) or
-                       (db_getabundance(targetampliconid)
-                        <= subseedabundance)))
-                    {
-                      qgramamps_v[subseedlistlen] = targetampliconid;
-                      qgramindices_v[subseedlistlen] = i;
-                      ++subseedlistlen;
-                    }
-                }
+  std::vector<unsigned char> directions;
+  std::vector<uint64_t> hearray;
+  std::vector<char> raw_alignment;
+  std::string cigar_string;
+  raw_alignment.reserve(2 * longestamplicon);
+  cigar_string.reserve(2 * longestamplicon);
 
-              qgram_diff_fast(subseedampliconid, subseedlistlen, qgramamps_v.data(),
-                              qgramdiffs_v.data(), thread_info_v);
+  if (parameters.uclustfile != nullptr)
+    {
+      directions.resize(longestamplicon * longestamplicon);
+      hearray.resize(2 * longestamplicon);
+    }
 
-              for(auto i = 0ULL; i < subseedlistlen; ++i) {
-                if (qgramdiffs_v[i] <= static_cast<uint64_t>(parameters.opt_differences))
-                  {
-                    targetindices[targetcount] = qgramindices_v[i];
-                    targetampliconids[targetcount] = qgramamps_v[i];
-                    ++targetcount;
-                  }
-              }
+  /* unswarmed amplicons are the ones not marked in swarmed_v */
+  const auto max_differences = static_cast<uint64_t>(parameters.opt_differences);
+  segindex_init(segment_index, static_cast<unsigned int>(max_differences), amplicons);
+
+  /* exact hash table of all amplicons, to find the microvariants of
+     a query without aligning them (as when d = 1) */
+  std::unique_ptr<unsigned char[]> hash_occupied_p;
+  std::unique_ptr<uint64_t[]> hash_values_p;
+  std::unique_ptr<unsigned int[]> hash_data_p;
+  hash_alloc(amplicons, hash_occupied_p, hash_values_p, hash_data_p);
+  for(auto amp = 0U; amp < amplicons; ++amp) {
+    hash_insert(amp);
+  }
 
-              if (targetcount > 0)
-                {
-                  search_do(subseedampliconid, targetcount, targetampliconids.data(),
-                            scores_v.data(), diffs_v.data(), alignlengths.data(), bits, search_threads.get());
+  /* always search in 8 bit mode unless resolution is very high */
+  static constexpr auto bit_mode_8 = 8;
+  static constexpr auto bit_mode_16 = 16;
+  auto bits = bit_mode_8;
+
+  if (static_cast<uint64_t>(parameters.opt_differences) > diff_saturation) {
+    bits = bit_mode_16;
+  }
 
-                  if (bits == bit_mode_8) {
-                    count_comparisons_8 += targetcount;
-                  }
-                  else {
-                    count_comparisons_16 += targetcount;
-                  }
+#ifdef __aarch64__
+#if !defined(DEBUG) || !defined(COVERAGE)
+  /* always use 16-bit version on aarch64 because it is faster */
+  bits = bit_mode_16;
+#endif
+#endif
 
-                  for(auto target_id = 0ULL; target_id < targetcount; ++target_id)
-                    {
-                      const auto diff = diffs_v[target_id];
-
-                      if (diff <= static_cast<uint64_t>(parameters.opt_differences))
-                        {
-                          const auto target = targetindices[target_id];
-
-                          /* find correct position in list */
-
-                          /* move the 'target' to the position (swarmed)
-                             of the first unswarmed amplicon in the pool
-                             then move the target further into the swarmed
-                             but unseeded part of the list, so that the
-                             swarmed amplicons are ordered by id */
-
-                          const uint64_t targetampliconid = amps_v[target].ampliconid;
-                          auto pos = swarmed;
-
-                          while ((pos > seeded) and
-                                 (amps_v[pos - 1].ampliconid > targetampliconid) and
-                                 (amps_v[pos - 1].generation > subseedgeneration)) {
-                            --pos;
-                          }
-
-                          if (pos < target)
-                            {
-                              auto const temp = amps_v[target];  // refactoring: static?
-                              for(auto j = target; j > pos; --j)
-                                {
-                                  amps_v[j] = amps_v[j - 1];
-                                }
-                              amps_v[pos] = temp;
-                            }
-
-                          amps_v[pos].swarmid = swarmid;
-                          assert(subseedgeneration + 1 <= std::numeric_limits<unsigned int>::max());
-                          amps_v[pos].generation =
-                              static_cast<unsigned int>(subseedgeneration + 1);
-                          maxgen = std::max<uint64_t>(maxgen, amps_v[pos].generation);
-                          assert(subseedradius + diff <= std::numeric_limits<unsigned int>::max());
-                          amps_v[pos].radius =
-                              static_cast<unsigned int>(subseedradius + diff);
-                          maxradius = std::max<uint64_t>(amps_v[pos].radius, maxradius);
-
-                          const auto poolampliconid = amps_v[pos].ampliconid;
-                          hits[hitcount] = poolampliconid;
-                          ++hitcount;
-
-                          if (not parameters.opt_internal_structure.empty())
-                            {
-                              fprint_id_noabundance(parameters.internal_structure_file,
-                                                    subseedampliconid,
-                                                    parameters.opt_usearch_abundance);
-                              std::fprintf(parameters.internal_structure_file, "\t");
-                              fprint_id_noabundance(parameters.internal_structure_file,
-                                                    poolampliconid,
-                                                    parameters.opt_usearch_abundance);
-                              std::fprintf(parameters.internal_structure_file, "\t%" PRIu64, diff);
-                              std::fprintf(parameters.internal_structure_file,
-                                      "\t%u\t%" PRIu64,
-                                      swarmid, subseedgeneration + 1);
-                              std::fprintf(parameters.internal_structure_file, "\n");
-                            }
-
-                          abundance = db_getabundance(poolampliconid);
-                          amplicons_copies += abundance;
-                          if (abundance == 1) {
-                            ++singletons;
-                          }
-
-                          ++swarmsize;
-
-                          ++swarmed;
-                        }
-                    }
-                }
-            }
-        }
+  static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
+  static constexpr auto offset = 4U;
+  std::vector<unsigned int> component_v(amplicons);  /* first member, by amplicon */
+  std::vector<unsigned int> component_members_v(amplicons);
+  std::vector<struct component_s> large_components_v;
+  std::vector<struct component_s> small_components_v;
+  struct clustering_s clustering_data;
+  clustering = &clustering_data;
+  clustering_data.index = &segment_index;
+  clustering_data.swarmed_v = &swarmed_v;
+  clustering_data.component_v = &component_v;
+  clustering_data.component_members_v = &component_members_v;
+  clustering_data.work_v.resize(static_cast<uint64_t>(parameters.opt_threads));
+  for(auto i = 0ULL; i < clustering_data.work_v.size(); ++i) {
+    clustering_data.work_v[i].search_data = &search_data_v[i];
+    clustering_data.work_v[i].variant_list.resize(multiplier * longestamplicon + offset);
+  }
+  clustering_data.differences = max_differences;
+  clustering_data.bits = bits;
+  clustering_data.no_cluster_breaking = parameters.opt_no_cluster_breaking;
+  clustering_data.align_substitutions =
+    parameters.penalty_mismatch >= 2 * (parameters.penalty_gapopen + parameters.penalty_gapextend);
+
+  if (parameters.opt_threads == 1) {
+    /* a single component */
+    for(auto amp = 0U; amp < amplicons; ++amp) {
+      component_members_v[amp] = amp;
+    }
+    struct component_s component {};
+    component.size = amplicons;
+    large_components_v.push_back(component);
+  }
+  else {
+    find_components(parameters, amplicons, component_v, component_members_v,
+                    large_components_v, small_components_v);
+  }
+
+  progress_init("Clustering:       ", amplicons);
+  for(auto const & component : large_components_v) {
+    cluster_component(clustering_data.work_v[0], component,
+                      parameters.opt_threads > 1, true);
+  }
+  if (not small_components_v.empty())
+    {
+      ChunkScheduler scheduler(small_components_v.size(),
+                               static_cast<uint64_t>(parameters.opt_threads), 1, 1);
+      clustering_data.scheduler = &scheduler;
+      clustering_data.components_v = &small_components_v;
+      thread_pool->run(component_worker);
+      clustering_data.scheduler = nullptr;
+      clustering_data.components_v = nullptr;
+    }
+  progress_done(parameters);
+
+  for(auto const & work : clustering_data.work_v) {
+    if (bits == bit_mode_8) {
+      count_comparisons_8 += work.comparisons;
+    }
+    else {
+      count_comparisons_16 += work.comparisons;
+    }
+  }
+
+  /* swarms are numbered in the order of their seeds */
+  std::vector<struct swarm_s const *> swarms_v;
+  for(auto const & work : clustering_data.work_v) {
+    for(auto const & swarm : work.swarms_v) {
+      swarms_v.push_back(&swarm);
+    }
+  }
+  std::sort(swarms_v.begin(), swarms_v.end(),
+            [](struct swarm_s const * lhs, struct swarm_s const * rhs) -> bool {
+              return lhs->seed < rhs->seed;
+            });
+
+  amps_v.reserve(amplicons);
+  auto swarmid = 0U;
+  for(auto const * swarm : swarms_v)
+    {
+      ++swarmid;
+      auto const & work = *swarm->work;
+      const uint64_t seedampliconid = swarm->seed;
+      const auto swarmsize = swarm->size;
+
+      for(auto i = 0ULL; i < swarmsize; ++i) {
+        amps_v.push_back(work.members_v[swarm->first_member + i]);
+        amps_v.back().swarmid = swarmid;
+      }
 
       largestswarm = std::max(swarmsize, largestswarm);
-      maxgenerations = std::max(maxgen, maxgenerations);
+      maxgenerations = std::max(swarm->maxgen, maxgenerations);
+
+      if (not parameters.opt_internal_structure.empty())
+        {
+          for(auto i = 1ULL; i < swarmsize; ++i)
+            {
+              auto const & link = work.links_v[swarm->first_link + i - 1];
+              fprint_id_noabundance(parameters.internal_structure_file,
+                                    link.subseed,
+                                    parameters.opt_usearch_abundance);
+              std::fprintf(parameters.internal_structure_file, "\t");
+              fprint_id_noabundance(parameters.internal_structure_file,
+                                    link.target,
+                                    parameters.opt_usearch_abundance);
+              std::fprintf(parameters.internal_structure_file, "\t%u", link.diff);
+              std::fprintf(parameters.internal_structure_file,
+                           "\t%u\t%u",
+                           swarmid, link.generation);
+              std::fprintf(parameters.internal_structure_file, "\n");
+            }
+        }
 
       if (parameters.uclustfile != nullptr)
         {
@@ -616,9 +1015,9 @@ auto algo_run(struct Parameters const & parameters,
           std::fprintf(parameters.uclustfile, "\t*\n");
           std::fflush(parameters.uclustfile);
 
-          for(auto i = 1ULL; i < hitcount; ++i)
+          for(auto i = 1ULL; i < swarmsize; ++i)
             {
-              const auto hit = hits[i];
+              const uint64_t hit = work.links_v[swarm->first_link + i - 1].target;
 
               auto * dseq = db_getsequence(hit);
               const auto dlen = db_getsequencelen(hit);
@@ -661,18 +1060,18 @@ auto algo_run(struct Parameters const & parameters,
 
       if (parameters.statsfile != nullptr)
         {
-          abundance = db_getabundance(seedampliconid);
+          const auto abundance = db_getabundance(seedampliconid);
 
           std::fprintf(parameters.statsfile, "%" PRIu64 "\t%" PRIu64 "\t",
-                  swarmsize, amplicons_copies);
+                  swarmsize, swarm->amplicons_copies);
           fprint_id_noabundance(parameters.statsfile, seedampliconid, parameters.opt_usearch_abundance);
           std::fprintf(parameters.statsfile,
                   "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n",
-                  abundance, singletons, maxgen, maxradius);
+                  abundance, swarm->singletons, swarm->maxgen, swarm->maxradius);
         }
-      progress_update(seeded);
     }
-  progress_done(parameters);
+  swarmed = amps_v.size();
+  clustering = nullptr;
 
   /* output swarms */
   if (amplicons > 0) {
@@ -692,7 +1091,9 @@ auto algo_run(struct Parameters const & parameters,
 
   db_qgrams_done();
 
-  qgram_diff_done();
+  segindex_exit(segment_index);
+
+  hash_free();
 
   std::fprintf(parameters.logfile, "\n");
 
@@ -701,7 +1102,4 @@ auto algo_run(struct Parameters const & parameters,
   std::fprintf(parameters.logfile, "Largest swarm:     %" PRIu64 "\n", largestswarm);
 
   std::fprintf(parameters.logfile, "Max generations:   %" PRIu64 "\n", maxgenerations);
-
-  search_end();
 }
-
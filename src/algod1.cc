@@ -32,18 +32,26 @@
 #include "bloomflex.h"
 #include "bloompat.h"
 #include "db.h"
+#include "fusefilter.h"
 #include "hashtable.h"
 #include "nw.h"
 #include "variants.h"
+#include "varindex.h"
 #include "utils/cigar.h"
+#include "utils/hashtable_size.h"
 #include "utils/nt_codec.h"
 #include "utils/opt_boundary.h"
+#include "utils/chunk_scheduler.h"
 #include "utils/opt_no_cluster_breaking.h"
 #include "utils/progress.h"
+#include "utils/radix_sort.h"
 #include "utils/score_matrix.h"
 #include "utils/threads.h"
+#include "utils/union_find.h"
 #include "zobrist.h"
 #include <algorithm>  // std::sort(), std::reverse(), std::max()
+#include <array>
+#include <atomic>
 #include <cassert>  // assert()
 #include <cinttypes>  // macros PRIu64 and PRId64
 #include <cstddef>  // std::ptrdiff_t
@@ -92,7 +100,7 @@ struct ampinfo_s
   unsigned int generation {0U};
   unsigned int next {no_swarm};        /* amp id of next amplicon in swarm */
   unsigned int graft_cand {no_swarm};  /* amp id of potential grafting parent (fastid.) */
-  unsigned int link_start {0U};
+  unsigned int link_start {0U};      /* in network_v (not when compressed) */
   unsigned int link_count {0U};
 };
 
@@ -125,93 +133,151 @@ struct graft_cand
 };
 
 /* Information about potential grafts */
-static int64_t graft_candidates {0};
-static pthread_mutex_t graft_mutex;
-
-static unsigned int current_swarm_tail {0};
+static std::atomic<int64_t> graft_candidates {0};
+/* lowest heavy seed found for each light amplicon (lock-free) */
+static std::vector<std::atomic<unsigned int>> * graft_parents {nullptr};
 
 /* overall statistics */
 static unsigned int maxgen {0};
 static unsigned int largest {0};
 static uint64_t swarmcount_adjusted {0};
 
-/* per swarm statistics */
-static unsigned int singletons {0};
-static uint64_t abundance_sum {0}; /* = mass */
-static unsigned int swarmsize {0};
-static unsigned int swarm_maxgen {0};
-static uint64_t swarm_sumlen {0};
-
-static unsigned int * global_hits_data {nullptr};
-
 static unsigned int longestamplicon {0};
 
 static unsigned int amplicons {0};
 
-static pthread_mutex_t heavy_mutex;
-static uint64_t heavy_variants {0};
-static uint64_t heavy_progress {0};
+/* work distribution: amplicons are handed out in batches */
+static constexpr uint64_t network_chunk_max {256};
+static constexpr uint64_t light_chunk_max {256};
+static constexpr uint64_t heavy_chunk_max {64};
+
+static std::atomic<uint64_t> heavy_variants {0};
 static uint64_t heavy_amplicon_count {0};
-static unsigned int heavy_amplicon {0};
+static ChunkScheduler * heavy_scheduler {nullptr};
 
-static pthread_mutex_t light_mutex;
-static uint64_t light_variants {0};
-static uint64_t light_progress {0};
+static std::atomic<uint64_t> light_variants {0};
 static uint64_t light_amplicon_count {0};
-static unsigned int light_amplicon {0};
+static unsigned int const * light_amplicons {nullptr};  /* of the current pass */
+static ChunkScheduler * light_scheduler {nullptr};
 
 std::vector<unsigned int> network_v;
+static bool network_stored {true};  /* if false, links are found on the fly */
+static bool network_compressed {false};  /* if true, links are delta-coded */
+static bool network_halved {false};  /* if true, each pair is probed once */
+static std::vector<std::vector<uint64_t>> * network_pairs {nullptr};  /* source, target */
+static std::vector<unsigned char> network_bytes_v;
+static std::vector<uint64_t> network_offsets_v;  /* by amplicon, when compressed */
 static unsigned int network_count {0};
+static uint64_t network_bytes {0};  /* may exceed 4 GiB */
 static pthread_mutex_t network_mutex;
-static unsigned int network_amp {0};
+static ChunkScheduler * network_scheduler {nullptr};
 
 static struct bloom_s * bloom_a {nullptr}; // Bloom filter for amplicons
 
+/* observed filter efficiency: a query is confirmed if the key is
+   really present, other positive answers are false positives */
+struct filter_stats_s
+{
+  uint64_t queries {0};
+  uint64_t positives {0};
+  uint64_t confirmed {0};
+};
+
+struct filter_counters_s
+{
+  std::atomic<uint64_t> queries {0};
+  std::atomic<uint64_t> positives {0};
+  std::atomic<uint64_t> confirmed {0};
+};
+
+static struct filter_counters_s amplicon_filter_counters;  /* bloom_a */
+static struct filter_counters_s light_filter_counters;  /* bloom_f or fuse_f */
+
 static struct bloomflex_s * bloom_f {nullptr}; // Huge Bloom filter for fastidious
 
+static struct fusefilter_s * fuse_f {nullptr}; // or binary fuse filter (fastidious)
+static std::vector<uint64_t> * light_keys {nullptr};  /* to build it */
+static std::atomic<uint64_t> light_key_count {0};
+
+static struct varindex_s * light_index {nullptr}; // or exact index (fastidious)
+static bool light_halves {false};  /* if true, light_index holds deletion neighbourhoods */
 
-inline auto check_amp_identical(unsigned int amp1,
-                                unsigned int amp2) -> bool
+
+inline auto index_amplicon(unsigned int const amp) -> void
 {
-  /* amplicon are identical if they have the same length, and the
-     exact same sequence */
-  const auto amp1_seqlen = db_getsequencelen(amp1);
-  const auto amp2_seqlen = db_getsequencelen(amp2);
-
-  return ((amp1_seqlen == amp2_seqlen) and
-          std::equal(db_getsequence(amp1),
-                     std::next(db_getsequence(amp1), nt_bytelength(amp1_seqlen)),
-                     db_getsequence(amp2)));
+  /* exact hash table and Bloom filter of amplicons */
+  if (hash_insert(amp)) {
+    ++duplicates_found;
+  }
+  bloom_set(bloom_a, db_gethash(amp));
 }
 
 
-inline auto hash_insert(unsigned int amp) -> void
+auto add_filter_stats(struct filter_counters_s & counters,
+                      struct filter_stats_s const & stats) -> void
 {
-  /* find the first empty bucket */
-  const auto hash = db_gethash(amp);
-  auto index = hash_getindex(hash);
-  auto duplicate = false;
-  while (hash_is_occupied(index))
-    {
-      if (hash_compare_value(index, hash) and
-          check_amp_identical(amp, hash_get_data(index))) {
-        duplicate = true;
-      }
-      index = hash_getnextindex(index);
-    }
+  counters.queries.fetch_add(stats.queries, std::memory_order_relaxed);
+  counters.positives.fetch_add(stats.positives, std::memory_order_relaxed);
+  counters.confirmed.fetch_add(stats.confirmed, std::memory_order_relaxed);
+}
 
-  if (duplicate) {
-    ++duplicates_found;
+
+auto report_filter_stats(struct Parameters const & parameters,
+                         char const * name,
+                         struct filter_counters_s const & counters) -> void
+{
+  const auto queries = counters.queries.load();
+  if (queries == 0) {
+    return;
   }
+  const auto positives = counters.positives.load();
+  const auto confirmed = counters.confirmed.load();
+  const auto false_positives = positives - confirmed;
+  const auto negatives = queries - confirmed;
+  static constexpr double percent {100.0};
+  std::fprintf(parameters.logfile,
+               "%s: %" PRIu64 " queries, %" PRIu64 " positives, %" PRIu64
+               " false positives (observed rate: %.4f%%)\n",
+               name, queries, positives, false_positives,
+               (negatives == 0) ? 0.0 :
+               percent * static_cast<double>(false_positives) / static_cast<double>(negatives));
+}
+
 
-  hash_set_occupied(index);
-  hash_set_value(index, hash);
-  hash_set_data(index, amp);
+constexpr unsigned int filter_batch {64};  // variants per batched filter query
 
-  bloom_set(bloom_a, hash);
+template <typename Query, typename Action>
+auto for_each_positive(std::vector<struct var_s> & variant_list,
+                       unsigned int const variant_count,
+                       Query query,
+                       Action action) -> void
+{
+  /* query a filter with the hashes of up to 64 variants at a time
+     (query returns a bitmask), and call action on the variants that
+     may be present, in their original order */
+  std::array<uint64_t, filter_batch> hashes {{}};
+  for(auto first = 0U; first < variant_count; first += filter_batch)
+    {
+      const auto count = std::min(filter_batch, variant_count - first);
+      for(auto j = 0U; j < count; ++j) {
+        hashes[j] = variant_list[first + j].hash;
+      }
+      const auto positives = query(hashes.data(), count);
+      for(auto j = 0U; j < count; ++j) {
+        if (((positives >> j) & 1U) != 0) {
+          action(variant_list[first + j]);
+        }
+      }
+    }
 }
 
 
+const auto amplicon_filter_query =
+  [](uint64_t const * hashes, unsigned int const count) -> uint64_t {
+    return bloom_get_batch(bloom_a, hashes, count);
+  };
+
+
 /******************** FASTIDIOUS START ********************/
 
 
@@ -247,18 +313,16 @@ auto attach(unsigned int seed, unsigned int amp,
 
 auto add_graft_candidate(unsigned int seed, unsigned int amp) -> void
 {
-  pthread_mutex_lock(&graft_mutex);
-  ++graft_candidates;
-  assert(amp <= std::numeric_limits<std::ptrdiff_t>::max());
-  auto const signed_position = static_cast<std::ptrdiff_t>(amp);
-  auto & amplicon = *std::next(ampinfo, signed_position);
-  // if there is no heavy candidate to graft amp, or if seed is
-  // earlier in the sorting order, then we change the attachment to
-  // seed
-  if ((amplicon.graft_cand == no_swarm) or (amplicon.graft_cand > seed)) {
-    amplicon.graft_cand = seed;
+  // if there is no heavy candidate to graft amp (no_swarm is the
+  // largest value), or if seed is earlier in the sorting order, then
+  // we change the attachment to seed (atomic minimum)
+  auto & graft_parent = (*graft_parents)[amp];
+  auto current = graft_parent.load(std::memory_order_relaxed);
+  while ((seed < current) and
+         (not graft_parent.compare_exchange_weak(current, seed,
+                                                 std::memory_order_relaxed))) {
+    // current now holds the latest value, try again
   }
-  pthread_mutex_unlock(&graft_mutex);
 }
 
 
@@ -388,12 +452,12 @@ inline auto check_heavy_var_2(std::vector<char>& seq,
   const auto hash = zobrist_hash(reinterpret_cast<unsigned char *>(seq.data()), seqlen);
   const auto variant_count = generate_variants(seq.data(), seqlen, hash, variant_list);  // refactoring: seq.data() not fixable while db returns char*
 
-  for(auto i = 0U; i < variant_count; ++i) {
-    if (bloom_get(bloom_a, variant_list[i].hash) and
-        hash_check_attach(seq.data(), seqlen, variant_list[i], seed)) {
-      ++matches;
-    }
-  }
+  for_each_positive(variant_list, variant_count, amplicon_filter_query,
+                    [&](struct var_s & var) {
+                      if (hash_check_attach(seq.data(), seqlen, var, seed)) {
+                        ++matches;
+                      }
+                    });
 
   return matches;
 }
@@ -405,7 +469,8 @@ auto check_heavy_var(struct bloomflex_s * bloom,
                      uint64_t & number_of_matches,
                      uint64_t & number_of_variants,
                      std::vector<struct var_s>& variant_list,
-                     std::vector<struct var_s>& variant_list2) -> void
+                     std::vector<struct var_s>& variant_list2,
+                     struct filter_stats_s & stats) -> void
 {
   /*
     bloom is a bloom filter in which to check the variants
@@ -434,32 +499,196 @@ auto check_heavy_var(struct bloomflex_s * bloom,
   const auto hash = db_gethash(seed);
   const auto variant_count = generate_variants(sequence, seqlen, hash, variant_list);
 
-  for(auto i = 0U; i < variant_count; ++i)
+  if (light_index != nullptr)
     {
-      struct var_s & var = variant_list[i];
-      if (bloomflex_get(bloom, var.hash))
+      /* exact index: light amplicons having this virtual amplicon
+         among their own microvariants are found directly */
+      for(auto i = 0U; i < variant_count; ++i)
         {
+          struct var_s & var = variant_list[i];
           auto varlen = 0U;
-          generate_variant_sequence(sequence, seqlen,
-                                    var, varseq, varlen);
-          matches += check_heavy_var_2(varseq,
-                                       varlen,
-                                       seed,
-                                       variant_list2);
+          const auto fingerprint = varindex_fingerprint(var.hash);
+          auto position = varindex_getindex(light_index, var.hash);
+          while (varindex_is_occupied(light_index, position))
+            {
+              auto const & entry = varindex_get(light_index, position);
+              if (entry.fingerprint == fingerprint)
+                {
+                  if (varlen == 0) {
+                    generate_variant_sequence(sequence, seqlen,
+                                              var, varseq, varlen);
+                  }
+                  const auto amp = entry.amp.load(std::memory_order_relaxed);
+                  auto light_var = unpack_variant(var.hash, entry.variant);
+                  if (check_variant(db_getsequence(amp), db_getsequencelen(amp), light_var,
+                                    varseq.data(), varlen))
+                    {
+                      add_graft_candidate(seed, amp);
+                      ++matches;
+                    }
+                }
+              position = varindex_getnextindex(light_index, position);
+            }
         }
+
+      number_of_matches = matches;
+      number_of_variants = variant_count;
+      return;
     }
 
+  for_each_positive(variant_list, variant_count,
+                    [bloom](uint64_t const * hashes, unsigned int const count) -> uint64_t {
+                      return (fuse_f != nullptr) ?
+                        fusefilter_get_batch(fuse_f, hashes, count) :
+                        bloomflex_get_batch(bloom, hashes, count);
+                    },
+                    [&](struct var_s & var) {
+                      auto varlen = 0U;
+                      generate_variant_sequence(sequence, seqlen,
+                                                var, varseq, varlen);
+                      const auto var_matches = check_heavy_var_2(varseq,
+                                                                 varlen,
+                                                                 seed,
+                                                                 variant_list2);
+                      matches += var_matches;
+                      ++stats.positives;
+                      if (var_matches != 0) {
+                        ++stats.confirmed;
+                      }
+                    });
+  stats.queries += variant_count;
+
   number_of_matches = matches;
   number_of_variants = variant_count;
 }
 
 
+/*
+  Deletion neighbourhood engine: a heavy amplicon and a light amplicon
+  are graft candidates if their edit distance is at most two (this is
+  the same as having a common microvariant). Cut the light amplicon in
+  two halves: one of them is at most one edit away from the
+  corresponding part of the heavy amplicon, so both share the segment
+  itself or one of its single-deletion variants. Light halves are
+  indexed with their deletion neighbourhoods, and the heavy amplicon is
+  queried with the neighbourhoods of all its prefixes and suffixes that
+  can match a half of a light amplicon of length L - 2 to L + 2.
+*/
+
+static constexpr uint64_t suffix_salt {0x9E3779B97F4A7C15};  // distinguishes halves
+static constexpr unsigned int prefix_half {0};
+static constexpr unsigned int suffix_half {1};
+
+
+auto mark_light_halves(unsigned int const seed,
+                       std::vector<uint64_t>& hashes) -> uint64_t
+{
+  auto *sequence = db_getsequence(seed);
+  const auto seqlen = db_getsequencelen(seed);
+  const auto middle = seqlen / 2;
+
+  const auto prefix_count =
+    generate_deletion_neighbourhood(sequence, 0, middle, hashes);
+  for(auto i = 0U; i < prefix_count; ++i) {
+    varindex_insert(light_index, hashes[i], seed, prefix_half);
+  }
+
+  const auto suffix_count =
+    generate_deletion_neighbourhood(sequence, middle, seqlen - middle, hashes);
+  for(auto i = 0U; i < suffix_count; ++i) {
+    varindex_insert(light_index, hashes[i] ^ suffix_salt, seed, suffix_half);
+  }
+
+  return prefix_count + suffix_count;
+}
+
+
+auto find_light_halves(char * sequence,
+                       unsigned int const start,
+                       unsigned int const length,
+                       unsigned int const half,
+                       std::vector<uint64_t>& hashes,
+                       std::vector<unsigned int>& candidates) -> uint64_t
+{
+  const auto salt = (half == suffix_half) ? suffix_salt : 0;
+  const auto hash_count =
+    generate_deletion_neighbourhood(sequence, start, length, hashes);
+  for(auto i = 0U; i < hash_count; ++i)
+    {
+      const auto hash = hashes[i] ^ salt;
+      const auto fingerprint = varindex_fingerprint(hash);
+      auto position = varindex_getindex(light_index, hash);
+      while (varindex_is_occupied(light_index, position))
+        {
+          auto const & entry = varindex_get(light_index, position);
+          if ((entry.fingerprint == fingerprint) and (entry.variant == half)) {
+            candidates.push_back(entry.amp.load(std::memory_order_relaxed));
+          }
+          position = varindex_getnextindex(light_index, position);
+        }
+    }
+  return hash_count;
+}
+
+
+auto check_heavy_halves(unsigned int const seed,
+                        uint64_t & number_of_matches,
+                        uint64_t & number_of_variants,
+                        std::vector<uint64_t>& hashes,
+                        std::vector<unsigned int>& candidates) -> void
+{
+  static constexpr auto max_distance = 2U;
+
+  auto *sequence = db_getsequence(seed);
+  const auto seqlen = db_getsequencelen(seed);
+
+  /* lengths of the light amplicons that can be two edits away, and
+     the lengths of their halves, plus or minus one edit */
+  const auto shortest = (seqlen > max_distance) ? seqlen - max_distance : 0;
+  const auto longest = seqlen + max_distance;
+  const auto first_prefix = (shortest / 2 > 0) ? (shortest / 2) - 1 : 0;
+  const auto last_prefix = std::min((longest / 2) + 1, seqlen);
+  const auto first_suffix = (shortest - (shortest / 2) > 0) ?
+    shortest - (shortest / 2) - 1 : 0;
+  const auto last_suffix = std::min(longest - (longest / 2) + 1, seqlen);
+
+  uint64_t variants {0};
+  candidates.clear();
+  for(auto length = first_prefix; length <= last_prefix; ++length) {
+    variants += find_light_halves(sequence, 0, length, prefix_half,
+                                  hashes, candidates);
+  }
+  for(auto length = first_suffix; length <= last_suffix; ++length) {
+    variants += find_light_halves(sequence, seqlen - length, length, suffix_half,
+                                  hashes, candidates);
+  }
+
+  /* verify each light amplicon once */
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                   candidates.end());
+
+  uint64_t matches {0};
+  for(auto const amp : candidates)
+    {
+      if (check_two_differences(sequence, seqlen,
+                                db_getsequence(amp), db_getsequencelen(amp)))
+        {
+          add_graft_candidate(seed, amp);
+          ++matches;
+        }
+    }
+
+  number_of_matches = matches;
+  number_of_variants = variants;
+}
+
+
 auto check_heavy_thread(int64_t nth_thread) -> void
 {
   static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
   static constexpr auto offset = 4U;
   static constexpr auto nt_per_uint64 = 32U;  // 32 nucleotides can fit in a uint64
-  (void) nth_thread;  // refactoring: unused parameter, replace with function overload?
 
   std::vector<struct var_s> variant_list(multiplier * longestamplicon + offset);
   std::vector<struct var_s> variant_list2(multiplier * (longestamplicon + 1) + offset);
@@ -467,32 +696,57 @@ auto check_heavy_thread(int64_t nth_thread) -> void
   const std::size_t size =
     sizeof(uint64_t) * ((db_getlongestsequence() + 2 + nt_per_uint64 - 1) / nt_per_uint64);
   std::vector<char> buffer1(size);
-  pthread_mutex_lock(&heavy_mutex);
-  while ((heavy_amplicon < amplicons) and
-         (heavy_progress < heavy_amplicon_count))
+  std::vector<uint64_t> hashes(light_halves ? longestamplicon + 1 : 0);
+  std::vector<unsigned int> light_candidates;
+
+  uint64_t first {0};
+  uint64_t count {0};
+  uint64_t heavy_done {0};
+  uint64_t variants {0};
+  int64_t candidates {0};
+  struct filter_stats_s stats;
+
+  /* process amplicons in order from most to least abundant */
+  /* but stop when all amplicons in large clusters are processed */
+  while ((heavy_done < heavy_amplicon_count) and
+         heavy_scheduler->get_chunk(first, count))
     {
-      auto const heavy_amplicon_id = heavy_amplicon;
-      ++heavy_amplicon;
-      assert(heavy_amplicon_id <= std::numeric_limits<std::ptrdiff_t>::max());
-      auto const signed_position = static_cast<std::ptrdiff_t>(heavy_amplicon_id);
-      auto const & target_amplicon = *std::next(ampinfo, signed_position);
-      assert(target_amplicon.swarmid <= std::numeric_limits<std::ptrdiff_t>::max());
-      auto const signed_swarmid = static_cast<std::ptrdiff_t>(target_amplicon.swarmid);
-      auto const & target_swarm = *std::next(swarminfo, signed_swarmid);
-      if (target_swarm.mass >= static_cast<uint64_t>(opt_boundary))
+      uint64_t processed {0};
+      for(auto heavy_amplicon_id = first; heavy_amplicon_id < first + count; ++heavy_amplicon_id)
         {
-          progress_update(++heavy_progress);  // refactoring: separate operations?
-          pthread_mutex_unlock(&heavy_mutex);
+          assert(heavy_amplicon_id <= std::numeric_limits<std::ptrdiff_t>::max());
+          auto const signed_position = static_cast<std::ptrdiff_t>(heavy_amplicon_id);
+          auto const & target_amplicon = *std::next(ampinfo, signed_position);
+          assert(target_amplicon.swarmid <= std::numeric_limits<std::ptrdiff_t>::max());
+          auto const signed_swarmid = static_cast<std::ptrdiff_t>(target_amplicon.swarmid);
+          auto const & target_swarm = *std::next(swarminfo, signed_swarmid);
+          if (target_swarm.mass < static_cast<uint64_t>(opt_boundary)) {
+            continue;
+          }
           uint64_t number_of_matches {0};
           uint64_t number_of_variants {0};
-          check_heavy_var(bloom_f, buffer1, heavy_amplicon_id,
-                          number_of_matches, number_of_variants,
-                          variant_list, variant_list2);
-          pthread_mutex_lock(&heavy_mutex);
-          heavy_variants += number_of_variants;
+          if (light_halves) {
+            check_heavy_halves(static_cast<unsigned int>(heavy_amplicon_id),
+                               number_of_matches, number_of_variants,
+                               hashes, light_candidates);
+          }
+          else {
+            check_heavy_var(bloom_f, buffer1, static_cast<unsigned int>(heavy_amplicon_id),
+                            number_of_matches, number_of_variants,
+                            variant_list, variant_list2, stats);
+          }
+          variants += number_of_variants;
+          candidates += static_cast<int64_t>(number_of_matches);
+          ++processed;
         }
+      heavy_done = heavy_scheduler->add_done(processed);
+      if (nth_thread == 0) {
+        progress_update(heavy_done);
+      }
     }
-  pthread_mutex_unlock(&heavy_mutex);
+  heavy_variants += variants;
+  graft_candidates += candidates;
+  add_filter_stats(light_filter_counters, stats);
 }
 
 
@@ -507,13 +761,34 @@ auto mark_light_var(struct bloomflex_s * bloom,
     seed is the original seed
   */
 
-  hash_insert(seed);
-
   auto *sequence = db_getsequence(seed);
   const auto seqlen = db_getsequencelen(seed);
   const auto hash = db_gethash(seed);
   const auto variant_count = generate_variants(sequence, seqlen, hash, variant_list);
 
+  if (light_index != nullptr)
+    {
+      /* exact index: the light amplicon is found through its variants */
+      for(auto i = 0U; i < variant_count; ++i) {
+        varindex_insert(light_index, variant_list[i].hash, seed,
+                        pack_variant(variant_list[i]));
+      }
+      return variant_count;
+    }
+
+  index_amplicon(seed);
+
+  if (light_keys != nullptr)
+    {
+      /* binary fuse filter: keep the keys, the filter is built later */
+      auto position = light_key_count.fetch_add(variant_count, std::memory_order_relaxed);
+      for(auto i = 0U; i < variant_count; ++i) {
+        (*light_keys)[position] = variant_list[i].hash;
+        ++position;
+      }
+      return variant_count;
+    }
+
   for(auto i = 0U; i < variant_count; ++i) {
     bloomflex_set(bloom, variant_list[i].hash);
   }
@@ -527,46 +802,63 @@ auto mark_light_thread(int64_t nth_thread) -> void
   static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
   static constexpr auto offset = 4U;
 
-  (void) nth_thread;  // refactoring: unused?
+  std::vector<struct var_s> variant_list(light_halves ? 0 : multiplier * longestamplicon + offset);
+  std::vector<uint64_t> hashes(light_halves ? longestamplicon + 1 : 0);
 
-  std::vector<struct var_s> variant_list(multiplier * longestamplicon + offset);
+  uint64_t first {0};
+  uint64_t count {0};
+  uint64_t light_done {0};
+  uint64_t variants {0};
 
-  pthread_mutex_lock(&light_mutex);
-  while (light_progress < light_amplicon_count)
+  /* light amplicons of the current pass, from least to most abundant */
+  while ((light_done < light_amplicon_count) and
+         light_scheduler->get_chunk(first, count))
     {
-      const auto light_amplicon_id = light_amplicon;
-      --light_amplicon;
-      assert(light_amplicon_id <= std::numeric_limits<std::ptrdiff_t>::max());
-      auto const signed_position = static_cast<std::ptrdiff_t>(light_amplicon_id);
-      auto const & target_amplicon = *std::next(ampinfo, signed_position);
-      assert(target_amplicon.swarmid <= std::numeric_limits<std::ptrdiff_t>::max());
-      auto const signed_swarmid = static_cast<std::ptrdiff_t>(target_amplicon.swarmid);
-      auto const & target_swarm = *std::next(swarminfo, signed_swarmid);
-      if (target_swarm.mass < static_cast<uint64_t>(opt_boundary))
+      uint64_t processed {0};
+      for(auto rank = first; rank < first + count; ++rank)
         {
-          progress_update(++light_progress);  // refactoring: separate operations?
-          pthread_mutex_unlock(&light_mutex);
-          const auto variant_count = mark_light_var(bloom_f, light_amplicon_id,
-                                                    variant_list);
-          pthread_mutex_lock(&light_mutex);
-          light_variants += variant_count;
+          assert(rank <= std::numeric_limits<std::ptrdiff_t>::max());
+          const auto light_amplicon_id =
+            *std::next(light_amplicons, static_cast<std::ptrdiff_t>(rank));
+          if (light_halves) {
+            variants += mark_light_halves(light_amplicon_id, hashes);
+          }
+          else {
+            variants += mark_light_var(bloom_f, light_amplicon_id, variant_list);
+          }
+          ++processed;
         }
+      light_done = light_scheduler->add_done(processed);
+      if (nth_thread == 0) {
+        progress_update(light_done);
+      }
     }
-  pthread_mutex_unlock(&light_mutex);
+  light_variants += variants;
 }
 
 
 /******************** FASTIDIOUS END ********************/
 
 
+inline auto is_link(unsigned int const seed, unsigned int const amp) -> bool
+{
+  /* links go from more (or equally) abundant amplicons to less
+     abundant amplicons, unless clusters are not broken */
+  return opt_no_cluster_breaking or
+    (db_getabundance(seed) >= db_getabundance(amp));
+}
+
+
 inline auto find_variant_matches(unsigned int seed,
                                  struct var_s & var,
                                  std::vector<unsigned int>& hits_data,
-                                 unsigned int & hits_count) -> void
+                                 unsigned int & hits_count,
+                                 struct filter_stats_s & stats,
+                                 bool const check_abundance = true) -> void
 {
-  if (not bloom_get(bloom_a, var.hash)) {
-    return;
-  }
+  /* var has passed the amplicon Bloom filter */
+  ++stats.positives;
+  auto present = false;
 
   /* compute hash and corresponding hash table index */
 
@@ -579,11 +871,11 @@ inline auto find_variant_matches(unsigned int seed,
       if (hash_compare_value(index, var.hash))
         {
           const auto amp = hash_get_data(index);
+          present = true;
 
           /* avoid self */
           if (seed != amp) {
-            if ((opt_no_cluster_breaking) or
-                (db_getabundance(seed) >= db_getabundance(amp)))
+            if ((not check_abundance) or is_link(seed, amp))
               {
                 auto *seed_sequence = db_getsequence(seed);
                 const auto seed_seqlen = db_getsequencelen(seed);
@@ -604,6 +896,10 @@ inline auto find_variant_matches(unsigned int seed,
         }
       index = hash_getnextindex(index);
     }
+
+  if (present) {
+    ++stats.confirmed;
+  }
 }
 
 
@@ -618,142 +914,1051 @@ auto check_variants(unsigned int seed,
   const auto hash = db_gethash(seed);
   const auto variant_count = generate_variants(sequence, seqlen, hash, variant_list);
 
-  // C++17 refactoring:
-  // std::for_each_n(variant_list.begin(), variant_count,
-  //                 [seed, &hits_data, &hits_count](auto& variant) {
-  //                   find_variant_matches(seed, variant, hits_data, hits_count);
-  //                 });
-  for(auto i = 0U; i < variant_count; ++i) {
-    find_variant_matches(seed, variant_list[i], hits_data, hits_count);
-  }
+  struct filter_stats_s stats;
+  stats.queries = variant_count;
+  for_each_positive(variant_list, variant_count, amplicon_filter_query,
+                    [&](struct var_s & var) {
+                      find_variant_matches(seed, var, hits_data, hits_count, stats);
+                    });
+  add_filter_stats(amplicon_filter_counters, stats);
 
   return hits_count;
 }
 
 
+auto check_half_variants(unsigned int seed,
+                         std::vector<struct var_s> & variant_list,
+                         std::vector<unsigned int>& hits_data) -> unsigned int
+{
+  /* find the microvariants of seed that are reached from seed's side
+     (see generate_half_variants()), regardless of their abundance */
+  auto hits_count = 0U;
+
+  auto * sequence = db_getsequence(seed);
+  const auto seqlen = db_getsequencelen(seed);
+  const auto hash = db_gethash(seed);
+  const auto variant_count = generate_half_variants(sequence, seqlen, hash, variant_list);
+
+  struct filter_stats_s stats;
+  stats.queries = variant_count;
+  for_each_positive(variant_list, variant_count, amplicon_filter_query,
+                    [&](struct var_s & var) {
+                      find_variant_matches(seed, var, hits_data, hits_count, stats, false);
+                    });
+  add_filter_stats(amplicon_filter_counters, stats);
+
+  return hits_count;
+}
+
+
+/* compressed network: the sorted links of an amplicon are stored as
+   gaps from the previous link, in little-endian base-128 varints */
+
+constexpr unsigned int varint_shift {7};
+constexpr unsigned int varint_more {1U << varint_shift};  // continuation bit
+constexpr unsigned int varint_mask {varint_more - 1};
+
+
+auto encode_links(unsigned int const * links,
+                  unsigned int const link_count,
+                  std::vector<unsigned char> & bytes) -> void
+{
+  auto previous = 0U;
+  for(auto link = 0U; link < link_count; ++link)
+    {
+      const auto amp = *std::next(links, link);
+      auto gap = amp - previous;
+      previous = amp;
+      while (gap >= varint_more)
+        {
+          bytes.push_back(static_cast<unsigned char>((gap & varint_mask) | varint_more));
+          gap >>= varint_shift;
+        }
+      bytes.push_back(static_cast<unsigned char>(gap));
+    }
+}
+
+
+auto decode_links(unsigned char const * bytes,
+                  unsigned int const link_count,
+                  unsigned int * links) -> void
+{
+  auto previous = 0U;
+  for(auto link = 0U; link < link_count; ++link)
+    {
+      auto gap = 0U;
+      auto shift = 0U;
+      while ((*bytes & varint_more) != 0U)
+        {
+          gap |= (*bytes & varint_mask) << shift;
+          shift += varint_shift;
+          std::advance(bytes, 1);
+        }
+      gap |= static_cast<unsigned int>(*bytes) << shift;
+      std::advance(bytes, 1);
+      previous += gap;
+      *std::next(links, link) = previous;
+    }
+}
+
+
+auto compressed_links(uint64_t const amp) -> unsigned char const *
+{
+  /* byte offsets are 64-bit: the compressed network of billions of
+     links passes 4 GiB before the plain network passes 2^32 links */
+  assert(network_offsets_v[amp] <= std::numeric_limits<std::ptrdiff_t>::max());
+  return std::next(network_bytes_v.data(),
+                   static_cast<std::ptrdiff_t>(network_offsets_v[amp]));
+}
+
+
+auto get_links(unsigned int const amp,
+               struct ampinfo_s const & amp_info,
+               std::vector<struct var_s> & variant_list,
+               std::vector<unsigned int> & hits_data,
+               unsigned int const * & links) -> unsigned int
+{
+  /* links are read from the network, or found by probing variants */
+  if (not network_stored) {
+    links = hits_data.data();
+    return check_variants(amp, variant_list, hits_data);
+  }
+  if (network_compressed) {
+    decode_links(compressed_links(amp), amp_info.link_count, hits_data.data());
+    links = hits_data.data();
+    return amp_info.link_count;
+  }
+  links = std::next(network_v.data(), amp_info.link_start);
+  return amp_info.link_count;
+}
+
+
+struct network_batch_s
+{
+  std::vector<unsigned int> hits;  /* links of all amplicons, in amplicon order */
+  std::vector<unsigned int> counts;  /* number of links of each amplicon */
+  std::vector<unsigned char> bytes;  /* compressed links */
+  std::vector<unsigned int> sizes;  /* number of bytes of each amplicon */
+};
+
+
+auto store_network_batch(uint64_t const first,
+                         uint64_t const count,
+                         struct network_batch_s & batch) -> void
+{
+  /* append the links of amplicons [first, first + count) to the network */
+  if (network_compressed)
+    {
+      batch.bytes.clear();
+      batch.sizes.clear();
+      auto * links = batch.hits.data();
+      for(auto const link_count : batch.counts)
+        {
+          const auto bytes_before = batch.bytes.size();
+          std::sort(links, std::next(links, link_count));
+          encode_links(links, link_count, batch.bytes);
+          batch.sizes.push_back(static_cast<unsigned int>(batch.bytes.size() - bytes_before));
+          links = std::next(links, link_count);
+        }
+    }
+
+  pthread_mutex_lock(&network_mutex);
+
+  if (network_compressed)
+    {
+      while (network_bytes + batch.bytes.size() > network_bytes_v.size()) {
+        network_bytes_v.reserve(network_bytes_v.size() + one_megabyte);
+        network_bytes_v.resize(network_bytes_v.size() + one_megabyte);
+      }
+
+      const auto batch_start = network_bytes;
+      for(auto i = 0U; i < count; ++i)
+        {
+          assert(first + i <= std::numeric_limits<std::ptrdiff_t>::max());
+          auto const signed_position = static_cast<std::ptrdiff_t>(first + i);
+          auto & target_amplicon = *std::next(ampinfo, signed_position);
+          network_offsets_v[first + i] = network_bytes;
+          target_amplicon.link_count = batch.counts[i];
+          network_bytes += batch.sizes[i];
+          network_count += batch.counts[i];
+        }
+      assert(batch_start <= std::numeric_limits<std::ptrdiff_t>::max());
+      std::copy(batch.bytes.begin(), batch.bytes.end(),
+                std::next(network_bytes_v.begin(), static_cast<std::ptrdiff_t>(batch_start)));
+    }
+  else
+    {
+      while (network_count + batch.hits.size() > network_v.size()) {
+        network_v.reserve(network_v.size() + one_megabyte);
+        network_v.resize(network_v.size() + one_megabyte);
+      }
+
+      const auto batch_start = network_count;
+      for(auto i = 0U; i < count; ++i)
+        {
+          assert(first + i <= std::numeric_limits<std::ptrdiff_t>::max());
+          auto const signed_position = static_cast<std::ptrdiff_t>(first + i);
+          auto & target_amplicon = *std::next(ampinfo, signed_position);
+          target_amplicon.link_start = network_count;
+          target_amplicon.link_count = batch.counts[i];
+          network_count += batch.counts[i];
+        }
+      std::copy(batch.hits.begin(), batch.hits.end(),
+                std::next(network_v.begin(), batch_start));
+    }
+
+  pthread_mutex_unlock(&network_mutex);
+}
+
+
 auto network_thread(int64_t nth_thread) -> void
 {
   static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
   static constexpr auto offset = 4U;
 
-  (void) nth_thread;  // refactoring: unused?
+  std::vector<unsigned int> hits_data(multiplier * longestamplicon + offset + 1);
+  std::vector<struct var_s> variant_list(multiplier * longestamplicon + offset + 1);
+
+  /* hits of a whole batch are collected before being appended to the network */
+  struct network_batch_s batch;
+  batch.counts.reserve(network_chunk_max);
+  batch.sizes.reserve(network_chunk_max);
+
+  uint64_t first {0};
+  uint64_t count {0};
+  while (network_scheduler->get_chunk(first, count))
+    {
+      batch.hits.clear();
+      batch.counts.clear();
+      for(auto amp = first; amp < first + count; ++amp)
+        {
+          const auto hits_count = check_variants(static_cast<unsigned int>(amp),
+                                                 variant_list, hits_data);
+          batch.counts.push_back(hits_count);
+          batch.hits.insert(batch.hits.end(), hits_data.begin(),
+                            std::next(hits_data.begin(), hits_count));
+        }
+
+      store_network_batch(first, count, batch);
+
+      const auto done = network_scheduler->add_done(count);
+      if (nth_thread == 0) {
+        progress_update(done);
+      }
+    }
+}
+
+
+/* with --symmetric-links, a directed link is collected as one pair:
+   source amplicon in the high half, target in the low half, so that
+   pairs sort by source, then target */
+
+constexpr unsigned int pair_shift {32};
+
+
+inline auto link_pair(unsigned int const source,
+                      unsigned int const target) -> uint64_t
+{
+  return (uint64_t{source} << pair_shift) | target;
+}
+
+
+inline auto pair_source(uint64_t const pair) -> unsigned int
+{
+  return static_cast<unsigned int>(pair >> pair_shift);
+}
+
+
+inline auto pair_target(uint64_t const pair) -> unsigned int
+{
+  return static_cast<unsigned int>(pair);
+}
+
+
+auto network_pairs_thread(int64_t nth_thread) -> void
+{
+  /* each pair of microvariants is found once, and stored as one or
+     two directed links (source, target) in this thread's list */
+  static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
+  static constexpr auto offset = 4U;
 
   std::vector<unsigned int> hits_data(multiplier * longestamplicon + offset + 1);
   std::vector<struct var_s> variant_list(multiplier * longestamplicon + offset + 1);
+  auto & pairs = *std::next(network_pairs->begin(), nth_thread);
 
-  pthread_mutex_lock(&network_mutex);
-  while (network_amp < amplicons)
+  uint64_t first {0};
+  uint64_t count {0};
+  while (network_scheduler->get_chunk(first, count))
     {
-      const auto amp = network_amp;
-      ++network_amp;
-      progress_update(amp);
+      for(auto amp = first; amp < first + count; ++amp)
+        {
+          const auto seed = static_cast<unsigned int>(amp);
+          const auto hits_count = check_half_variants(seed, variant_list, hits_data);
+          for(auto i = 0U; i < hits_count; ++i)
+            {
+              const auto neighbour = hits_data[i];
+              if (is_link(seed, neighbour)) {
+                pairs.push_back(link_pair(seed, neighbour));
+              }
+              if (is_link(neighbour, seed)) {
+                pairs.push_back(link_pair(neighbour, seed));
+              }
+            }
+        }
+      const auto done = network_scheduler->add_done(count);
+      if (nth_thread == 0) {
+        progress_update(done);
+      }
+    }
+}
+
+
+auto network_from_pairs(std::vector<struct ampinfo_s> & ampinfo_v,
+                        std::vector<std::vector<uint64_t>> & pairs_v) -> void
+{
+  /* links are collected as pairs (8 bytes per link). Without
+     compression, they are counting-sorted by source amplicon into the
+     network (4 bytes per link), and the pairs of each thread are
+     freed once copied: at worst, 12 bytes per link. With compression,
+     the pairs of each thread are sorted in place and merged one
+     source amplicon at a time, each list of links being encoded
+     straight into the compressed network: at worst, 8 bytes per link
+     plus the compressed network. */
+  network_count = 0;
+  for(auto & amplicon : ampinfo_v) {
+    amplicon.link_count = 0;
+  }
+
+  if (network_compressed) {
+    for(auto & pairs : pairs_v) {
+      std::sort(pairs.begin(), pairs.end());
+    }
+    std::vector<uint64_t> cursors_v(pairs_v.size());
+    std::vector<unsigned int> links;
+    for(auto amp = 0U; amp < ampinfo_v.size(); ++amp) {
+      links.clear();
+      for(auto nth_pairs = 0UL; nth_pairs < pairs_v.size(); ++nth_pairs) {
+        auto const & pairs = pairs_v[nth_pairs];
+        auto & cursor = cursors_v[nth_pairs];
+        while ((cursor < pairs.size()) and (pair_source(pairs[cursor]) == amp)) {
+          links.push_back(pair_target(pairs[cursor]));
+          ++cursor;
+        }
+      }
+      std::sort(links.begin(), links.end());
+      auto & amplicon = ampinfo_v[amp];
+      network_offsets_v[amp] = network_bytes_v.size();
+      amplicon.link_count = static_cast<unsigned int>(links.size());
+      encode_links(links.data(), amplicon.link_count, network_bytes_v);
+      network_count += amplicon.link_count;
+    }
+    network_bytes = network_bytes_v.size();
+    pairs_v.clear();
+    pairs_v.shrink_to_fit();
+    return;
+  }
+
+  /* counting sort of the directed links by source amplicon */
+  for(auto const & pairs : pairs_v) {
+    for(auto const pair : pairs) {
+      ++ampinfo_v[pair_source(pair)].link_count;
+    }
+  }
+  for(auto & amplicon : ampinfo_v) {
+    amplicon.link_start = network_count;
+    network_count += amplicon.link_count;
+    amplicon.link_count = 0;
+  }
+
+  network_v.resize(network_count);
+  for(auto & pairs : pairs_v) {
+    for(auto const pair : pairs) {
+      auto & source = ampinfo_v[pair_source(pair)];
+      network_v[source.link_start + source.link_count] = pair_target(pair);
+      ++source.link_count;
+    }
+    pairs.clear();
+    pairs.shrink_to_fit();
+  }
+  pairs_v.clear();
+  pairs_v.shrink_to_fit();
+}
+
+
+/******************** MERGE JOIN START ********************/
+
+/*
+  With --merge-join, the network is built without probing the hash
+  table. Amplicons are sorted once by sequence hash, and indexed by the
+  top bits of their hash (join prefix). Each thread then takes a block
+  of amplicons, lists their variants as (hash, seed, variant) tuples
+  (variants rejected by the amplicon Bloom filter are dropped), radix
+  sorts them by join prefix, and walks both lists
+  together: amplicons are read sequentially, and only a few entries
+  sharing the same prefix are searched for each variant. Candidates
+  are verified with check_variant(), as in find_variant_matches().
+*/
+
+struct join_amp_s
+{
+  uint64_t hash;
+  unsigned int amp;
+  unsigned int dummy; /* for alignment padding only */
+};
+
+struct join_variant_s
+{
+  uint64_t hash;
+  unsigned int seed;
+  unsigned int variant;  /* packed position, type and base */
+};
+
+static constexpr unsigned int join_block_variants {1U << 18U};  // per block
+static constexpr unsigned int join_prefix_bits {16};
+static constexpr unsigned int join_prefix_shift {64 - join_prefix_bits};
+
+static bool network_joined {false};  /* if true, links are found by merge join */
+static std::vector<struct join_amp_s> join_amps_v;
+static std::vector<unsigned int> join_starts_v;  /* first amplicon of each prefix */
+
+
+auto join_block_size() -> unsigned int
+{
+  /* number of amplicons whose variants fill a block */
+  static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
+  static constexpr auto offset = 4U;
+  return std::max(1U, join_block_variants / (multiplier * longestamplicon + offset));
+}
+
+
+auto sort_join_amplicons() -> void
+{
+  join_amps_v.resize(amplicons);
+  for(auto amp = 0U; amp < amplicons; ++amp) {
+    join_amps_v[amp].hash = db_gethash(amp);
+    join_amps_v[amp].amp = amp;
+  }
+  std::vector<struct join_amp_s> buffer;
+  radix_sort(join_amps_v, buffer,
+             [](struct join_amp_s const & entry) -> uint64_t { return entry.hash; });
+
+  join_starts_v.assign((1UL << join_prefix_bits) + 1, 0);
+  for(auto const & entry : join_amps_v) {
+    ++join_starts_v[(entry.hash >> join_prefix_shift) + 1];
+  }
+  for(auto i = 1UL; i < join_starts_v.size(); ++i) {
+    join_starts_v[i] += join_starts_v[i - 1];
+  }
+}
+
+
+auto join_variants(std::vector<struct join_variant_s> const & tuples,
+                   std::vector<unsigned int> & matches) -> void
+{
+  /* tuples are sorted by prefix, so amplicons are read in order */
+  const auto compare = [](struct join_amp_s const & entry, uint64_t const hash) -> bool {
+    return entry.hash < hash;
+  };
+
+  for(auto const & tuple : tuples)
+    {
+      const auto prefix = tuple.hash >> join_prefix_shift;
+      const auto amp_end = std::next(join_amps_v.cbegin(), join_starts_v[prefix + 1]);
+      auto candidate = std::lower_bound(std::next(join_amps_v.cbegin(), join_starts_v[prefix]),
+                                        amp_end, tuple.hash, compare);
+
+      for(; (candidate != amp_end) and (candidate->hash == tuple.hash); ++candidate)
+        {
+          const auto seed = tuple.seed;
+          const auto amp = candidate->amp;
+          if ((seed == amp) or
+              ((not network_halved) and (not is_link(seed, amp)))) {
+            continue;
+          }
+          auto var = unpack_variant(tuple.hash, tuple.variant);
+          if (check_variant(db_getsequence(seed), db_getsequencelen(seed), var,
+                            db_getsequence(amp), db_getsequencelen(amp)))
+            {
+              matches.push_back(seed);
+              matches.push_back(amp);
+              break;
+            }
+        }
+    }
+}
+
+
+auto join_thread(int64_t nth_thread) -> void
+{
+  static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
+  static constexpr auto offset = 4U;
+
+  std::vector<struct var_s> variant_list(multiplier * longestamplicon + offset + 1);
+  std::vector<struct join_variant_s> tuples;
+  std::vector<struct join_variant_s> buffer;
+  std::vector<unsigned int> matches;  /* (seed, amp) pairs */
+  std::vector<unsigned int> starts;
+  struct network_batch_s batch;
+  auto & pairs = *std::next(network_pairs->begin(), nth_thread);
+
+  uint64_t first {0};
+  uint64_t count {0};
+  while (network_scheduler->get_chunk(first, count))
+    {
+      /* list the variants of this block, sorted by hash */
+      tuples.clear();
+      for(auto amp = first; amp < first + count; ++amp)
+        {
+          const auto seed = static_cast<unsigned int>(amp);
+          auto * sequence = db_getsequence(seed);
+          const auto seqlen = db_getsequencelen(seed);
+          const auto hash = db_gethash(seed);
+          const auto variant_count = network_halved ?
+            generate_half_variants(sequence, seqlen, hash, variant_list) :
+            generate_variants(sequence, seqlen, hash, variant_list);
+          /* most variants are absent, and are dropped before sorting */
+          for_each_positive(variant_list, variant_count, amplicon_filter_query,
+                            [&](struct var_s & var) {
+                              tuples.push_back({var.hash, seed, pack_variant(var)});
+                            });
+        }
+      radix_sort(tuples, buffer,
+                 [](struct join_variant_s const & tuple) -> uint64_t {
+                   return tuple.hash >> join_prefix_shift;
+                 },
+                 join_prefix_bits);
+
+      matches.clear();
+      join_variants(tuples, matches);
+
+      if (network_halved)
+        {
+          for(auto i = 0UL; i < matches.size(); i += 2)
+            {
+              const auto seed = matches[i];
+              const auto neighbour = matches[i + 1];
+              if (is_link(seed, neighbour)) {
+                pairs.push_back(link_pair(seed, neighbour));
+              }
+              if (is_link(neighbour, seed)) {
+                pairs.push_back(link_pair(neighbour, seed));
+              }
+            }
+        }
+      else
+        {
+          /* group matches by seed (counting sort) */
+          batch.counts.assign(count, 0);
+          for(auto i = 0UL; i < matches.size(); i += 2) {
+            ++batch.counts[matches[i] - first];
+          }
+          starts.assign(count, 0);
+          for(auto i = 1UL; i < count; ++i) {
+            starts[i] = starts[i - 1] + batch.counts[i - 1];
+          }
+          batch.hits.resize(matches.size() / 2);
+          for(auto i = 0UL; i < matches.size(); i += 2) {
+            batch.hits[starts[matches[i] - first]++] = matches[i + 1];
+          }
+          store_network_batch(first, count, batch);
+        }
+
+      const auto done = network_scheduler->add_done(count);
+      if (nth_thread == 0) {
+        progress_update(done);
+      }
+    }
+}
+
+/******************** MERGE JOIN END ********************/
+
+
+auto update_swarm_stats(unsigned int const seed,
+                        struct ampinfo_s const & seed_info,
+                        struct swarminfo_s & swarm_info) -> void
+{
+  ++swarm_info.size;
+  swarm_info.maxgen = std::max(seed_info.generation, swarm_info.maxgen);
+  const auto abundance = db_getabundance(seed);
+  swarm_info.mass += abundance;
+  if (abundance == 1) {
+    ++swarm_info.singletons;
+  }
+  swarm_info.sumlen += db_getsequencelen(seed);
+}
+
+
+auto add_links(unsigned int const seed,
+               unsigned int const * links,
+               unsigned int const link_count,
+               std::vector<struct ampinfo_s> & ampinfo_v,
+               std::vector<unsigned int> & global_hits_v,
+               unsigned int & global_hits_count) -> void
+{
+  /* unswarmed neighbours of seed join the next generation */
+  auto global_hits_alloc = global_hits_v.size();
+
+  if (global_hits_count + link_count > global_hits_alloc)
+    {
+      while (global_hits_count + link_count > global_hits_alloc) {
+        global_hits_alloc += 4UL * one_kilobyte;
+      }
+      global_hits_v.resize(global_hits_alloc);
+    }
+
+  for(auto offset = 0U; offset < link_count; ++offset)
+    {
+      const auto amp = *std::next(links, offset);
+
+      if (ampinfo_v[amp].swarmid == no_swarm)
+        {
+          global_hits_v[global_hits_count] = amp;
+          ++global_hits_count;
+
+          /* update info */
+          ampinfo_v[amp].swarmid = ampinfo_v[seed].swarmid;
+          ampinfo_v[amp].generation = ampinfo_v[seed].generation + 1;
+          ampinfo_v[amp].parent = seed;
+        }
+    }
+}
+
+
+auto process_seed(unsigned int const seed,
+                  std::vector<struct ampinfo_s> & ampinfo_v,
+                  std::vector<unsigned int> & global_hits_v,
+                  unsigned int & global_hits_count,
+                  struct swarminfo_s & swarm_info,
+                  std::vector<struct var_s> & variant_list,
+                  std::vector<unsigned int> & hits_data) -> void
+{
+  update_swarm_stats(seed, ampinfo_v[seed], swarm_info);
+
+  unsigned int const * links {nullptr};
+  const auto link_count = get_links(seed, ampinfo_v[seed], variant_list, hits_data, links);
+  add_links(seed, links, link_count, ampinfo_v, global_hits_v, global_hits_count);
+}
+
+
+/******************** LAZY CLUSTERING START ********************/
+
+/*
+  With --lazy-clustering, no network is built: the variants of an
+  amplicon are probed when the swarm reaches it, so that each amplicon
+  is expanded exactly once and memory does not depend on the number of
+  links. Subseeds of large generations are expanded concurrently, and
+  their links are merged in subseed order, as in the serial case.
+*/
+
+static constexpr unsigned int generation_parallel_min {64};  // smaller ones are serial
+
+struct expansion_s
+{
+  std::vector<struct var_s> variant_list;
+  std::vector<unsigned int> hits_data;
+  std::vector<unsigned int> links;
+  std::vector<unsigned int> link_counts;
+};
+
+static std::vector<struct expansion_s> * expansions {nullptr};  /* with threads */
+static std::vector<unsigned int> generation_v;
+
+
+auto expand_thread(int64_t nth_thread) -> void
+{
+  /* each thread expands a contiguous range of the generation */
+  auto & expansion = *std::next(expansions->begin(), nth_thread);
+  const auto thread_count = expansions->size();
+  const auto subseeds = generation_v.size();
+  const auto first = subseeds * static_cast<uint64_t>(nth_thread) / thread_count;
+  const auto last = subseeds * static_cast<uint64_t>(nth_thread + 1) / thread_count;
+
+  expansion.links.clear();
+  expansion.link_counts.clear();
+  for(auto rank = first; rank < last; ++rank)
+    {
+      const auto hits_count = check_variants(generation_v[rank], expansion.variant_list,
+                                             expansion.hits_data);
+      expansion.link_counts.push_back(hits_count);
+      expansion.links.insert(expansion.links.end(), expansion.hits_data.begin(),
+                             std::next(expansion.hits_data.begin(), hits_count));
+    }
+}
+
+
+auto process_generation(unsigned int subseed,
+                        std::vector<struct ampinfo_s> & ampinfo_v,
+                        std::vector<unsigned int> & global_hits_v,
+                        unsigned int & global_hits_count,
+                        struct swarminfo_s & swarm_info,
+                        std::vector<struct var_s> & variant_list,
+                        std::vector<unsigned int> & hits_data) -> void
+{
+  /* process all subseeds of this generation */
+  generation_v.clear();
+  if (expansions != nullptr) {
+    for(auto amp = subseed; amp != no_swarm; amp = ampinfo_v[amp].next) {
+      generation_v.push_back(amp);
+    }
+  }
+
+  if (generation_v.size() < generation_parallel_min)
+    {
+      while(subseed != no_swarm)
+        {
+          process_seed(subseed, ampinfo_v, global_hits_v, global_hits_count, swarm_info,
+                       variant_list, hits_data);
+          subseed = ampinfo_v[subseed].next;
+        }
+      return;
+    }
+
+  thread_pool->run(expand_thread);
+
+  auto rank = 0UL;
+  for(auto const & expansion : *expansions)
+    {
+      auto const * links = expansion.links.data();
+      for(auto const link_count : expansion.link_counts)
+        {
+          const auto seed = generation_v[rank];
+          update_swarm_stats(seed, ampinfo_v[seed], swarm_info);
+          add_links(seed, links, link_count, ampinfo_v, global_hits_v, global_hits_count);
+          links = std::next(links, link_count);
+          ++rank;
+        }
+    }
+}
+
+/******************** LAZY CLUSTERING END ********************/
+
+
+auto compare_amp(const void * void_lhs, const void * void_rhs) -> int
+{
+  /*
+    earlier steps in swarm check that all amplicon sequences are
+    unique (strictly dereplicated input data), so distinct amplicons
+    with the same sequence are not expected at this stage.
+  */
+  const auto * lhs = static_cast<const unsigned int*>(void_lhs);
+  const auto * rhs = static_cast<const unsigned int*>(void_rhs);
+  auto status = 1;  // default is *lhs > *rhs
+
+  assert(*lhs != *rhs);  // '*lhs == *rhs' is not expected at that stage
+
+  // compare amplicon index values (unsigned ints). Amplicon indexes
+  // are already sorted by decreasing abundance then by header in
+  // db.cc, so smaller indexes should go first. This corresponds to a
+  // natural order sorting.
+  if (*lhs < *rhs) {
+    status = -1;
+  }
+
+  return status;
+}
+
+
+inline auto add_amp_to_swarm(unsigned int const amp,
+                             std::vector<struct ampinfo_s> & ampinfo_v,
+                             struct swarminfo_s & swarm_info) -> void
+{
+  /* add to swarm */
+  ampinfo_v[swarm_info.last].next = amp;
+  swarm_info.last = amp;
+}
+
+
+auto build_swarm(unsigned int const seed,
+                 unsigned int const swarmid,
+                 std::vector<struct ampinfo_s> & ampinfo_v,
+                 std::vector<unsigned int> & global_hits_v,
+                 std::vector<struct var_s> & variant_list,
+                 std::vector<unsigned int> & hits_data) -> struct swarminfo_s
+{
+  /* grow a new swarm from an initial seed, generation by generation */
+  auto & seed_info = ampinfo_v[seed];
+
+  seed_info.swarmid = swarmid;
+  seed_info.generation = 0;
+  seed_info.parent = no_swarm;
+  seed_info.next = no_swarm;
+
+  /* link up this initial seed in the list of swarms */
+  struct swarminfo_s swarm_info;
+  swarm_info.seed = seed;
+  swarm_info.last = seed;
+
+  /* init list */
+  auto global_hits_count = 0U;
+
+  /* find the first generation matches */
+  process_seed(seed, ampinfo_v, global_hits_v, global_hits_count, swarm_info,
+               variant_list, hits_data);
+
+  /* sort hits */
+  std::sort(global_hits_v.begin(), std::next(global_hits_v.begin(), global_hits_count));
+
+  /* add subseeds on list to current swarm */
+  for(auto i = 0U; i < global_hits_count; ++i) {
+    add_amp_to_swarm(global_hits_v[i], ampinfo_v, swarm_info);
+  }
+
+  /* find later generation matches */
+  auto subseed = seed_info.next;
+  while(subseed != no_swarm)
+    {
+      /* process all subseeds of this generation */
+      global_hits_count = 0;
+
+      process_generation(subseed, ampinfo_v, global_hits_v, global_hits_count, swarm_info,
+                         variant_list, hits_data);
+
+      /* sort all of this generation */
+      std::sort(global_hits_v.begin(), std::next(global_hits_v.begin(), global_hits_count));
+
+      /* add them to the swarm */
+      for(auto i = 0U; i < global_hits_count; ++i) {
+        add_amp_to_swarm(global_hits_v[i], ampinfo_v, swarm_info);
+      }
+
+      /* start with most abundant amplicon of next generation */
+      if (global_hits_count != 0U) {
+        subseed = global_hits_v[0];
+      }
+      else {
+        subseed = no_swarm;
+      }
+    }
+
+  return swarm_info;
+}
 
-      pthread_mutex_unlock(&network_mutex);
 
-      const auto hits_count = check_variants(amp, variant_list, hits_data);
-      pthread_mutex_lock(&network_mutex);
+/******************** PARALLEL CLUSTERING START ********************/
 
-      assert(amp <= std::numeric_limits<std::ptrdiff_t>::max());
-      auto const signed_position = static_cast<std::ptrdiff_t>(amp);
-      auto & target_amplicon = *std::next(ampinfo, signed_position);
-      target_amplicon.link_start = network_count;
-      target_amplicon.link_count = hits_count;
+/*
+  Swarms never extend beyond the weakly connected component of the
+  network containing their initial seed. Components are found with a
+  lock-free union-find and clustered concurrently, each one with the
+  serial algorithm (seeds in increasing amplicon id order). Swarms
+  are temporarily identified by their seed, then renumbered in seed
+  order, which yields the same results as the serial pass.
+
+  With --no-otu-breaking, links are symmetric and swarms are exactly
+  the connected components of the microvariant graph. The network is
+  not stored in that case: unions are made while variants are probed,
+  and variants are probed again when components are clustered to
+  restore the usual generation order.
+*/
 
-      while (network_count + hits_count > network_v.size()) {
-        network_v.reserve(network_v.size() + one_megabyte);
-        network_v.resize(network_v.size() + one_megabyte);
-      }
+static constexpr uint64_t union_chunk_max {1024};
+static constexpr uint64_t component_chunk_max {16};
 
-      for(auto k = 0U; k < hits_count; ++k) {
-        network_v[network_count] = hits_data[k];
-        ++network_count;
-      }
-    }
-  pthread_mutex_unlock(&network_mutex);
-}
+static UnionFind * network_components {nullptr};
+static ChunkScheduler * union_scheduler {nullptr};
+static ChunkScheduler * component_scheduler {nullptr};
+static std::vector<struct ampinfo_s> * component_ampinfo {nullptr};
+static unsigned int * component_start {nullptr};
+static unsigned int * component_members {nullptr};
+static unsigned int * component_order {nullptr};
+static std::vector<struct swarminfo_s> * component_swarms {nullptr};
 
 
-auto process_seed(unsigned int const seed,
-                  std::vector<struct ampinfo_s> & ampinfo_v,
-                  std::vector<unsigned int> & global_hits_v,
-                  unsigned int & global_hits_count) -> void
+auto union_thread(int64_t nth_thread) -> void
 {
-  /* update swarm stats */
-  auto const & seed_info = ampinfo_v[seed];
+  static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
+  static constexpr auto offset = 4U;
 
-  ++swarmsize;
-  swarm_maxgen = std::max(seed_info.generation, swarm_maxgen);
-  const auto abundance = db_getabundance(seed);
-  abundance_sum += abundance;
-  if (abundance == 1) {
-    ++singletons;
+  std::vector<unsigned int> hits_data;
+  std::vector<struct var_s> variant_list;
+  if (network_compressed or not network_stored) {
+    hits_data.resize(multiplier * longestamplicon + offset + 1);
+    variant_list.resize(multiplier * longestamplicon + offset + 1);
   }
-  swarm_sumlen += db_getsequencelen(seed);
 
-  const auto link_start = ampinfo_v[seed].link_start;
-  const auto link_count = ampinfo_v[seed].link_count;
-  auto global_hits_alloc = global_hits_v.size();
-
-  if (global_hits_count + link_count > global_hits_alloc)
+  uint64_t first {0};
+  uint64_t count {0};
+  while (union_scheduler->get_chunk(first, count))
     {
-      while (global_hits_count + link_count > global_hits_alloc) {
-        global_hits_alloc += 4UL * one_kilobyte;
+      for(auto amp = first; amp < first + count; ++amp)
+        {
+          assert(amp <= std::numeric_limits<std::ptrdiff_t>::max());
+          auto const & amplicon = *std::next(ampinfo, static_cast<std::ptrdiff_t>(amp));
+          unsigned int const * links {hits_data.data()};
+          auto link_count = 0U;
+          if (network_halved and not network_stored) {
+            /* with --no-otu-breaking, all microvariants are linked */
+            link_count = check_half_variants(static_cast<unsigned int>(amp),
+                                             variant_list, hits_data);
+          }
+          else {
+            link_count = get_links(static_cast<unsigned int>(amp), amplicon,
+                                   variant_list, hits_data, links);
+          }
+          for(auto link = 0U; link < link_count; ++link) {
+            network_components->unite(static_cast<unsigned int>(amp),
+                                      *std::next(links, link));
+          }
+        }
+      const auto done = union_scheduler->add_done(count);
+      if ((nth_thread == 0) and (not network_stored)) {
+        progress_update(done);
       }
-      global_hits_v.resize(global_hits_alloc);
-      global_hits_data = global_hits_v.data();
     }
+}
 
-  for(auto offset = 0U; offset < link_count; ++offset)
-    {
-      const auto amp = network_v[link_start + offset];
 
-      if (ampinfo_v[amp].swarmid == no_swarm)
-        {
-          global_hits_v[global_hits_count] = amp;
-          ++global_hits_count;
+auto component_thread(int64_t nth_thread) -> void
+{
+  static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
+  static constexpr auto offset = 4U;
+  auto & swarms = *std::next(component_swarms, nth_thread);
+  auto & ampinfo_v = *component_ampinfo;
+  std::vector<unsigned int> global_hits_v(multiplier * longestamplicon + offset + 1);
+  std::vector<unsigned int> hits_data;
+  std::vector<struct var_s> variant_list;
+  if (network_compressed or not network_stored) {
+    hits_data.resize(multiplier * longestamplicon + offset + 1);
+    variant_list.resize(multiplier * longestamplicon + offset + 1);
+  }
 
-          /* update info */
-          ampinfo_v[amp].swarmid = ampinfo_v[seed].swarmid;
-          ampinfo_v[amp].generation = ampinfo_v[seed].generation + 1;
-          ampinfo_v[amp].parent = seed;
+  uint64_t first {0};
+  uint64_t count {0};
+  while (component_scheduler->get_chunk(first, count))
+    {
+      uint64_t processed {0};
+      for(auto rank = first; rank < first + count; ++rank)
+        {
+          assert(rank <= std::numeric_limits<std::ptrdiff_t>::max());
+          const auto component = static_cast<std::ptrdiff_t>(*std::next(component_order, static_cast<std::ptrdiff_t>(rank)));
+          const auto start = *std::next(component_start, component);
+          const auto end = *std::next(component_start, component + 1);
+          for(auto i = start; i < end; ++i)
+            {
+              const auto seed = *std::next(component_members, static_cast<std::ptrdiff_t>(i));
+              if (ampinfo_v[seed].swarmid == no_swarm) {
+                /* temporary swarm id: the id of the initial seed */
+                swarms.push_back(build_swarm(seed, seed, ampinfo_v, global_hits_v,
+                                             variant_list, hits_data));
+              }
+            }
+          processed += end - start;
         }
+      const auto done = component_scheduler->add_done(processed);
+      if (nth_thread == 0) {
+        progress_update(done);
+      }
     }
 }
 
 
-auto compare_amp(const void * void_lhs, const void * void_rhs) -> int
+auto cluster_parallel(struct Parameters const & parameters,
+                      std::vector<struct ampinfo_s> & ampinfo_v) -> std::vector<struct swarminfo_s>
 {
-  /*
-    earlier steps in swarm check that all amplicon sequences are
-    unique (strictly dereplicated input data), so distinct amplicons
-    with the same sequence are not expected at this stage.
-  */
-  const auto * lhs = static_cast<const unsigned int*>(void_lhs);
-  const auto * rhs = static_cast<const unsigned int*>(void_rhs);
-  auto status = 1;  // default is *lhs > *rhs
-
-  assert(*lhs != *rhs);  // '*lhs == *rhs' is not expected at that stage
+  const auto thread_count = static_cast<uint64_t>(parameters.opt_threads);
 
-  // compare amplicon index values (unsigned ints). Amplicon indexes
-  // are already sorted by decreasing abundance then by header in
-  // db.cc, so smaller indexes should go first. This corresponds to a
-  // natural order sorting.
-  if (*lhs < *rhs) {
-    status = -1;
+  /* find weakly connected components */
+  UnionFind components(amplicons);
+  network_components = &components;
+  if (not network_stored) {
+    progress_init("Linking amplicons:", amplicons);
+  }
+  {
+    ChunkScheduler scheduler(amplicons, thread_count, 1,
+                             network_stored ? union_chunk_max : network_chunk_max);
+    union_scheduler = &scheduler;
+    thread_pool->run(union_thread);
+    union_scheduler = nullptr;
+  }
+  if (not network_stored) {
+    progress_done(parameters);
   }
 
-  return status;
-}
+  /* list members of each component in increasing amplicon id
+     order; the root of a component is its smallest amplicon id */
+  std::vector<unsigned int> component_of(amplicons);
+  std::vector<unsigned int> start_v(1, 0);
+  for(auto amp = 0U; amp < amplicons; ++amp)
+    {
+      const auto root = components.find(amp);
+      if (root == amp) {
+        component_of[amp] = static_cast<unsigned int>(start_v.size() - 1);
+        start_v.push_back(0);
+      }
+      else {
+        component_of[amp] = component_of[root];
+      }
+      ++start_v[component_of[amp] + 1];
+    }
+  network_components = nullptr;
+  std::partial_sum(start_v.begin(), start_v.end(), start_v.begin());
 
+  const auto component_count = start_v.size() - 1;
+  std::vector<unsigned int> members_v(amplicons);
+  {
+    std::vector<unsigned int> fill(start_v.begin(), std::prev(start_v.end()));
+    for(auto amp = 0U; amp < amplicons; ++amp) {
+      members_v[fill[component_of[amp]]] = amp;
+      ++fill[component_of[amp]];
+    }
+  }
+  component_of.clear();
+  component_of.shrink_to_fit();
+
+  /* largest components first, for a better load balance */
+  std::vector<unsigned int> order_v(component_count);
+  std::iota(order_v.begin(), order_v.end(), 0);
+  std::stable_sort(order_v.begin(), order_v.end(),
+                   [&start_v](unsigned int const lhs, unsigned int const rhs) -> bool {
+                     return start_v[lhs + 1] - start_v[lhs] > start_v[rhs + 1] - start_v[rhs];
+                   });
+
+  /* cluster components concurrently */
+  progress_init("Clustering:       ", amplicons);
+  std::vector<std::vector<struct swarminfo_s>> swarms_per_thread(thread_count);
+  component_ampinfo = &ampinfo_v;
+  component_start = start_v.data();
+  component_members = members_v.data();
+  component_order = order_v.data();
+  component_swarms = swarms_per_thread.data();
+  {
+    ChunkScheduler scheduler(component_count, thread_count, 1, component_chunk_max);
+    component_scheduler = &scheduler;
+    thread_pool->run(component_thread);
+    component_scheduler = nullptr;
+  }
+  progress_done(parameters);
+  component_ampinfo = nullptr;
+  component_start = nullptr;
+  component_members = nullptr;
+  component_order = nullptr;
+  component_swarms = nullptr;
+
+  /* merge, then renumber swarms in order of their initial seeds */
+  std::vector<struct swarminfo_s> swarms;
+  swarms.reserve(component_count);
+  for(auto const & thread_swarms : swarms_per_thread) {
+    swarms.insert(swarms.end(), thread_swarms.begin(), thread_swarms.end());
+  }
+  swarms_per_thread.clear();
+  std::sort(swarms.begin(), swarms.end(),
+            [](struct swarminfo_s const & lhs, struct swarminfo_s const & rhs) -> bool {
+              return lhs.seed < rhs.seed;
+            });
+
+  auto swarmid = 0U;
+  for(auto const & swarm_info : swarms) {
+    for(auto amp_id = swarm_info.seed; amp_id != no_swarm; amp_id = ampinfo_v[amp_id].next) {
+      ampinfo_v[amp_id].swarmid = swarmid;
+    }
+    ++swarmid;
+  }
 
-inline auto add_amp_to_swarm(unsigned int const amp,
-                             std::vector<struct ampinfo_s> & ampinfo_v) -> void
-{
-  /* add to swarm */
-  ampinfo_v[current_swarm_tail].next = amp;
-  current_swarm_tail = amp;
+  return swarms;
 }
 
+/******************** PARALLEL CLUSTERING END ********************/
+
 
 auto write_network_file(const unsigned int number_of_networks,
                         struct Parameters const & parameters,
@@ -761,23 +1966,37 @@ auto write_network_file(const unsigned int number_of_networks,
   // a network is a cluster with at least two sequences (no singletons)
   progress_init("Dumping network:  ", number_of_networks);
 
+  static constexpr auto multiplier = 7U;  // max number of microvariants = 7 * len + 4
+  static constexpr auto offset = 4U;
+
+  /* compressed links are decoded here, already sorted */
+  std::vector<unsigned int> links_v;
+  if (network_compressed) {
+    links_v.resize(multiplier * longestamplicon + offset + 1);
+  }
+
   uint64_t n_processed = 0;  // refactoring: reduce scope (move into the for loop init)
   assert(ampinfo_v.size() == amplicons);
   auto counter = 0ULL;
   for(auto const& amplicon: ampinfo_v) {
-    const auto link_start = amplicon.link_start;
     const auto link_count = amplicon.link_count;
+    auto const * links = links_v.data();
 
-    // refactoring: add network tests before replacing with std::sort
-    std::qsort(&network_v[link_start],
-               link_count,
-               sizeof(unsigned int),
-               compare_amp);
+    if (network_compressed) {
+      decode_links(compressed_links(counter), link_count, links_v.data());
+    }
+    else {
+      // refactoring: add network tests before replacing with std::sort
+      std::qsort(&network_v[amplicon.link_start],
+                 link_count,
+                 sizeof(unsigned int),
+                 compare_amp);
+      links = &network_v[amplicon.link_start];
+    }
 
-    // refactoring: std::vector<unsigned int> network_v(network_v.begin() + link_start, network_v.begin() + link_start + link_count);
     for(auto link = 0U; link < link_count; ++link)
       {
-        const auto neighbour = network_v[link_start + link];
+        const auto neighbour = *std::next(links, link);
         fprint_id(parameters.network_file, counter, parameters.opt_usearch_abundance, parameters.opt_append_abundance);
         std::fprintf(parameters.network_file, "\t");
         fprint_id(parameters.network_file, neighbour, parameters.opt_usearch_abundance, parameters.opt_append_abundance);
@@ -1098,6 +2317,280 @@ auto output_results(struct Parameters const & parameters,
 }
 
 
+auto fastidious_bloom_init(struct Parameters const & parameters,
+                           uint64_t const nucleotides_in_small_clusters,
+                           uint64_t const light_variant_count,
+                           struct bloomflex_s & bloomflex_filter) -> struct bloomflex_s *
+{
+  /* m: total size of Bloom filter in bits */
+  /* k: number of hash functions (n_hash_functions) */
+  /* n: number of entries in the bloom filter */
+  /* here: k=11 and m/n=18, that is 16 bits/entry */
+
+  static constexpr auto microvariants = 7U;
+  static constexpr auto n_bits_in_a_byte = 8U;
+  static constexpr double hash_functions_per_bit {4.0 / 10};
+  static constexpr double natural_log_of_2 {0.693147181};  // C++26 refactoring: std::log(2.0)
+  static_assert(hash_functions_per_bit <= natural_log_of_2, "upper limit is log(2)");
+  static constexpr uint64_t min_auto_bits {2};
+  static constexpr uint64_t max_auto_bits {32};  // lower false positive rates are not needed
+  static constexpr uint64_t auto_memory_share {2};  // use at most half of the free memory
+  assert(parameters.opt_bloom_bits <= std::numeric_limits<unsigned int>::max());
+  assert(parameters.opt_bloom_bits <= 64);  // larger than expected
+  assert(parameters.opt_bloom_bits >= 2);  // smaller than expected
+  auto bits = static_cast<uint64_t>(parameters.opt_bloom_bits);
+
+  /* upper bound of the number of entries: 7 microvariants per nucleotide */
+  uint64_t entries = nucleotides_in_small_clusters * microvariants;
+
+  const uint64_t memtotal = arch_get_memtotal();
+  const uint64_t memused = arch_get_memused();
+
+  if (parameters.opt_bloom_auto)
+    {
+      /* size the filter for the actual number of light microvariants,
+         with as many bits per entry as half of the free memory allows */
+      entries = std::max(light_variant_count, uint64_t{1});
+      const uint64_t memlimit = (parameters.opt_ceiling != 0) ?
+        static_cast<uint64_t>(parameters.opt_ceiling) * one_megabyte : memtotal;
+      const uint64_t memfree = (memlimit > memused) ? memlimit - memused : 0;
+      bits = n_bits_in_a_byte * (memfree / auto_memory_share) / entries;
+      bits = std::min(std::max(bits, min_auto_bits), max_auto_bits);
+      std::fprintf(parameters.logfile,
+                   "Automatic Bloom filter sizing: %" PRIu64 " light variants, "
+                   "%" PRIu64 " bits per entry\n", light_variant_count, bits);
+    }
+
+  auto bits_uint = static_cast<unsigned int>(bits);  // avoid risky conversion warning: uint64 to double
+
+  // int64_t n_hash_functions = int(bits * std::log(2.0));    /* 16 bits -> 11 hash functions */
+  // auto n_hash_functions = unsigned int(hash_functions_per_bit * bits); /* 6 */
+  auto n_hash_functions = std::max(static_cast<unsigned int>(hash_functions_per_bit * bits_uint), 1U);
+
+  uint64_t bloom_length_in_bits = entries * bits;
+
+  if ((parameters.opt_ceiling != 0) and (not parameters.opt_multi_pass))
+    {
+      if (static_cast<uint64_t>(parameters.opt_ceiling) * one_megabyte < memused)
+        {
+          fatal(error_prefix, "Memory ceiling for Bloom filter is too low.");
+        }
+      assert(memused < one_megabyte * static_cast<uint64_t>(parameters.opt_ceiling));
+      const uint64_t memrest
+        = one_megabyte * static_cast<uint64_t>(parameters.opt_ceiling) - memused;
+      auto const new_bits = n_bits_in_a_byte * memrest / entries;
+      if (new_bits < bits)
+        {
+          if (new_bits < 2) {
+            fatal(error_prefix, "Insufficient memory remaining for Bloom filter.");
+          }
+          std::fprintf(parameters.logfile, "Reducing memory used for Bloom filter due to --ceiling option.\n");
+          bits = new_bits;
+          bits_uint = static_cast<unsigned int>(new_bits);
+          n_hash_functions = std::max(static_cast<unsigned int>(hash_functions_per_bit * bits_uint), 1U);
+          bloom_length_in_bits = entries * bits;
+        }
+    }
+
+  static constexpr uint64_t min_bloom_length_in_bits {64};  // at least 64 bits
+  bloom_length_in_bits = std::max(bloom_length_in_bits, min_bloom_length_in_bits);
+
+  if (memused + bloom_length_in_bits / n_bits_in_a_byte > memtotal)
+    {
+      std::fprintf(parameters.logfile, "WARNING: Memory usage will probably exceed total amount of memory available.\n");
+      std::fprintf(parameters.logfile, "Try to reduce memory footprint using the --bloom-bits or --ceiling options.\n");
+    }
+
+  std::fprintf(parameters.logfile,
+               "Bloom filter: bits=%" PRIu64 ", m=%" PRIu64 ", k=%u, size=%.1fMB\n",
+               bits, bloom_length_in_bits, n_hash_functions, static_cast<double>(bloom_length_in_bits) / (n_bits_in_a_byte * one_megabyte));
+
+
+  // bloom_length is in bits (divide by 8 to get bytes)
+  // bloom_length is guaranteed to be at least 64 (see code above)
+  assert(bloom_length_in_bits != 0);  // safeguard for future changes
+  assert(bloom_length_in_bits >= 64);
+  const uint64_t n_bytes = ((bloom_length_in_bits - 1) / n_bits_in_a_byte) + 1;
+  return bloomflex_init(n_bytes, n_hash_functions, bloomflex_filter);
+}
+
+
+auto fastidious_index_init(struct Parameters const & parameters,
+                           uint64_t const nucleotides_in_small_clusters,
+                           uint64_t const amplicons_in_small_clusters,
+                           struct varindex_s & index) -> struct varindex_s *
+{
+  /* exact index: one entry per microvariant of light amplicons, or
+     deletion index: one entry per single-deletion variant of each
+     half of the light amplicons (plus the halves themselves) */
+  static constexpr auto microvariants = 7U;
+  static constexpr auto offset = 4U;
+  static constexpr auto halves = 2U;
+  const uint64_t entries =
+    (parameters.opt_fastidious_index == Fastidious_index::deletion) ?
+    nucleotides_in_small_clusters + halves * amplicons_in_small_clusters :
+    microvariants * nucleotides_in_small_clusters +
+    offset * amplicons_in_small_clusters;
+  const uint64_t index_size = compute_hashtable_size(entries) * sizeof(struct varindex_entry_s);
+
+  const uint64_t memtotal = arch_get_memtotal();
+  const uint64_t memused = arch_get_memused();
+
+  if ((parameters.opt_ceiling != 0) and (not parameters.opt_multi_pass) and
+      (memused + index_size > static_cast<uint64_t>(parameters.opt_ceiling) * one_megabyte))
+    {
+      fatal(error_prefix, "Memory ceiling too low for the variant index "
+            "(try --fastidious-index bloom).");
+    }
+
+  if (memused + index_size > memtotal)
+    {
+      std::fprintf(parameters.logfile, "WARNING: Memory usage will probably exceed total amount of memory available.\n");
+      std::fprintf(parameters.logfile, "Try to reduce memory footprint using --fastidious-index bloom.\n");
+    }
+
+  std::fprintf(parameters.logfile,
+               "Variant index: entries=%" PRIu64 ", size=%.1fMB\n",
+               entries, static_cast<double>(index_size) / one_megabyte);
+
+  return varindex_init(entries, index);
+}
+
+
+auto fastidious_fuse_init(struct Parameters const & parameters,
+                          uint64_t const nucleotides_in_small_clusters,
+                          uint64_t const amplicons_in_small_clusters,
+                          std::vector<uint64_t> & keys) -> std::vector<uint64_t> *
+{
+  /* binary fuse filter: the microvariants of light amplicons are
+     collected first, the filter is built once they are all known */
+  static constexpr auto microvariants = 7U;
+  static constexpr auto offset = 4U;
+  const uint64_t entries = microvariants * nucleotides_in_small_clusters +
+    offset * amplicons_in_small_clusters;
+  const uint64_t build_size = entries * sizeof(uint64_t) + fusefilter_memory(entries);
+
+  const uint64_t memtotal = arch_get_memtotal();
+  const uint64_t memused = arch_get_memused();
+
+  if ((parameters.opt_ceiling != 0) and (not parameters.opt_multi_pass) and
+      (memused + build_size > static_cast<uint64_t>(parameters.opt_ceiling) * one_megabyte))
+    {
+      fatal(error_prefix, "Memory ceiling too low to build the binary fuse filter "
+            "(try --multi-pass).");
+    }
+
+  if (memused + build_size > memtotal)
+    {
+      std::fprintf(parameters.logfile, "WARNING: Memory usage will probably exceed total amount of memory available.\n");
+      std::fprintf(parameters.logfile, "Try to reduce memory footprint using --fastidious-index bloom.\n");
+    }
+
+  keys.resize(entries);
+  light_key_count = 0;
+  return &keys;
+}
+
+
+auto fastidious_fuse_build(struct Parameters const & parameters,
+                           std::vector<uint64_t> & keys,
+                           struct fusefilter_s & filter) -> struct fusefilter_s *
+{
+  keys.resize(light_key_count.load());
+  auto * fuse_filter = fusefilter_init(keys, filter);
+  if (fuse_filter == nullptr) {
+    fatal(error_prefix, "Unable to build the binary fuse filter.");
+  }
+  std::fprintf(parameters.logfile,
+               "Binary fuse filter: keys=%" PRIu64 ", size=%.1fMB\n",
+               keys.size(),
+               static_cast<double>(fusefilter_size(fuse_filter)) / one_megabyte);
+
+  // release memory
+  keys.clear();
+  keys.shrink_to_fit();
+  return fuse_filter;
+}
+
+
+auto fastidious_memory(struct Parameters const & parameters,
+                       uint64_t const nucleotides,
+                       uint64_t const amplicon_count) -> uint64_t
+{
+  /* bytes needed to store the light amplicons of a pass (see
+     fastidious_bloom_init() and fastidious_index_init()) */
+  static constexpr auto microvariants = 7U;
+  static constexpr auto offset = 4U;
+  static constexpr auto halves = 2U;
+  static constexpr auto n_bits_in_a_byte = 8U;
+  static constexpr uint64_t min_bloom_length_in_bits {64};
+
+  switch (parameters.opt_fastidious_index)
+    {
+    case Fastidious_index::exact:
+      return compute_hashtable_size(microvariants * nucleotides + offset * amplicon_count) *
+        sizeof(struct varindex_entry_s);
+    case Fastidious_index::deletion:
+      return compute_hashtable_size(nucleotides + halves * amplicon_count) *
+        sizeof(struct varindex_entry_s);
+    case Fastidious_index::fuse:
+      return (microvariants * nucleotides + offset * amplicon_count) * sizeof(uint64_t) +
+        fusefilter_memory(microvariants * nucleotides + offset * amplicon_count);
+    case Fastidious_index::bloom:
+      break;
+    }
+  const auto bloom_length_in_bits =
+    std::max(nucleotides * microvariants * static_cast<uint64_t>(parameters.opt_bloom_bits),
+             min_bloom_length_in_bits);
+  return ((bloom_length_in_bits - 1) / n_bits_in_a_byte) + 1;
+}
+
+
+auto fastidious_passes(struct Parameters const & parameters,
+                       std::vector<unsigned int> const & light_amplicons_v) -> std::vector<uint64_t>
+{
+  /* split light amplicons in consecutive batches, each small enough
+     to be stored under the --ceiling limit; return the end of each
+     batch. Heavy amplicons are checked against each batch in turn,
+     and graft candidates are merged across passes. */
+  std::vector<uint64_t> pass_ends;
+
+  if (not parameters.opt_multi_pass)
+    {
+      pass_ends.push_back(light_amplicons_v.size());
+      return pass_ends;
+    }
+
+  const uint64_t memused = arch_get_memused();
+  const uint64_t ceiling = static_cast<uint64_t>(parameters.opt_ceiling) * one_megabyte;
+  if (ceiling < memused) {
+    fatal(error_prefix, "Memory ceiling for fastidious processing is too low.");
+  }
+  const uint64_t memrest = ceiling - memused;
+
+  uint64_t nucleotides {0};
+  uint64_t amplicon_count {0};
+  for(auto i = 0ULL; i < light_amplicons_v.size(); ++i)
+    {
+      const auto seqlen = db_getsequencelen(light_amplicons_v[i]);
+      if (fastidious_memory(parameters, nucleotides + seqlen, amplicon_count + 1) > memrest)
+        {
+          if (amplicon_count == 0) {
+            fatal(error_prefix, "Insufficient memory remaining for fastidious processing.");
+          }
+          pass_ends.push_back(i);
+          nucleotides = 0;
+          amplicon_count = 0;
+        }
+      nucleotides += seqlen;
+      ++amplicon_count;
+    }
+  pass_ends.push_back(light_amplicons_v.size());
+
+  return pass_ends;
+}
+
+
 auto algo_d1_run(struct Parameters const & parameters) -> void
 {
   longestamplicon = db_getlongestsequence();
@@ -1114,16 +2607,15 @@ auto algo_d1_run(struct Parameters const & parameters) -> void
   static constexpr auto offset = 4U;
   const auto global_hits_alloc = multiplier * longestamplicon + offset + 1;
   std::vector<unsigned int> global_hits_v(global_hits_alloc);
-  global_hits_data = global_hits_v.data();
 
   /* compute hash for all amplicons and store them in a hash table */
-  std::vector<unsigned char> hash_occupied_v;
-  std::vector<uint64_t> hash_values_v;
-  std::vector<unsigned int> hash_data_v;
+  std::unique_ptr<unsigned char[]> hash_occupied_p;
+  std::unique_ptr<uint64_t[]> hash_values_p;
+  std::unique_ptr<unsigned int[]> hash_data_p;
   const auto hashtablesize = hash_alloc(amplicons,
-                                        hash_occupied_v,
-                                        hash_values_v,
-                                        hash_data_v);
+                                        hash_occupied_p,
+                                        hash_values_p,
+                                        hash_data_p);
   struct bloom_s bloom_filter;
   bloom_a = bloom_init(hashtablesize, bloom_filter);
 
@@ -1132,7 +2624,7 @@ auto algo_d1_run(struct Parameters const & parameters) -> void
   progress_init("Hashing sequences:", amplicons);
   for(auto k = 0U; k < amplicons; ++k)
     {
-      hash_insert(k);
+      index_amplicon(k);
       progress_update(k);
       if (duplicates_found != 0U) {
         break;
@@ -1152,23 +2644,67 @@ auto algo_d1_run(struct Parameters const & parameters) -> void
 
   progress_done(parameters);
 
-  /* for all amplicons, generate list of matching amplicons */
-  network_v.resize(one_megabyte);
+  /* with --no-otu-breaking, swarms are connected components and
+     links can be found on the fly (unless the network is dumped) */
+  network_stored = not ((parameters.opt_no_cluster_breaking or
+                         parameters.opt_lazy_clustering) and
+                        parameters.opt_network_file.empty());
+  network_compressed = network_stored and parameters.opt_compress_network;
+  network_halved = parameters.opt_symmetric_links;
+  network_joined = parameters.opt_merge_join;
 
-  network_count = 0;
+  if (network_stored)
+    {
+      /* for all amplicons, generate list of matching amplicons */
+      /* (when halved, links are collected as pairs, then sorted by source) */
+      if (not network_halved) {
+        if (network_compressed) {
+          network_bytes_v.resize(one_megabyte);
+        }
+        else {
+          network_v.resize(one_megabyte);
+        }
+      }
 
-  pthread_mutex_init(&network_mutex, nullptr);
-  network_amp = 0;
-  progress_init("Building network: ", amplicons);
-  {
-    assert(parameters.opt_threads <= std::numeric_limits<int>::max());
-    // refactoring C++14: use std::make_unique
-    std::unique_ptr<ThreadRunner> network_tr (new ThreadRunner(static_cast<int>(parameters.opt_threads), network_thread));
-    network_tr->run();
-  }
-  pthread_mutex_destroy(&network_mutex);
+      network_count = 0;
+      network_bytes = 0;
+      if (network_compressed) {
+        network_offsets_v.resize(amplicons);
+      }
 
-  progress_done(parameters);
+      std::vector<std::vector<uint64_t>> pairs_v(static_cast<uint64_t>(parameters.opt_threads));
+      network_pairs = &pairs_v;
+
+      auto * network_function = network_halved ? network_pairs_thread : network_thread;
+      auto chunk_max = static_cast<uint64_t>(network_chunk_max);
+      if (network_joined) {
+        sort_join_amplicons();
+        network_function = join_thread;
+        chunk_max = join_block_size();
+      }
+
+      pthread_mutex_init(&network_mutex, nullptr);
+      progress_init("Building network: ", amplicons);
+      {
+        ChunkScheduler scheduler(amplicons, static_cast<uint64_t>(parameters.opt_threads),
+                                 1, chunk_max);
+        network_scheduler = &scheduler;
+        thread_pool->run(network_function);
+        network_scheduler = nullptr;
+      }
+      pthread_mutex_destroy(&network_mutex);
+      join_amps_v.clear();
+      join_amps_v.shrink_to_fit();
+      join_starts_v.clear();
+      join_starts_v.shrink_to_fit();
+
+      if (network_halved) {
+        network_from_pairs(ampinfo_v, pairs_v);
+      }
+      network_pairs = nullptr;
+
+      progress_done(parameters);
+    }
 
 
   /* dump network to file */
@@ -1180,112 +2716,84 @@ auto algo_d1_run(struct Parameters const & parameters) -> void
   /* for each non-swarmed amplicon look for subseeds ... */
 
   auto swarmcount = 0U;  // refactoring: find a way to know swarmcount in advance?
-  progress_init("Clustering:       ", amplicons);
-
-  for(auto seed = 0U; seed < amplicons; ++seed)
-    {
-      auto & seed_info = ampinfo_v[seed];
-
-      if (seed_info.swarmid == no_swarm)
-        {
-          /* start a new swarm with a new initial seed */
-
-          seed_info.swarmid = swarmcount;
-          seed_info.generation = 0;
-          seed_info.parent = no_swarm;
-          seed_info.next = no_swarm;
-
-          /* link up this initial seed in the list of swarms */
-          current_swarm_tail = seed;
-
-          /* initialize swarm stats */
-          swarmsize = 0;
-          swarm_maxgen = 0;
-          abundance_sum = 0;
-          singletons = 0;
-          swarm_sumlen = 0;
 
-          /* init list */
-          auto global_hits_count = 0U;
+  const auto lazy = parameters.opt_lazy_clustering and not network_stored;
 
-          /* find the first generation matches */
-          process_seed(seed, ampinfo_v, global_hits_v, global_hits_count);
-
-          /* sort hits */
-          std::sort(global_hits_v.begin(), global_hits_v.begin() + global_hits_count);
+  if ((parameters.opt_threads > 1) and not lazy)
+    {
+      swarminfo_v = cluster_parallel(parameters, ampinfo_v);
+      swarminfo = swarminfo_v.data();
+      assert(swarminfo_v.size() <= std::numeric_limits<unsigned int>::max());
+      swarmcount = static_cast<unsigned int>(swarminfo_v.size());
+      for(auto const & swarm_info : swarminfo_v) {
+        /* update overall stats */
+        largest = std::max(swarm_info.size, largest);
+        maxgen = std::max(swarm_info.maxgen, maxgen);
+      }
+    }
+  else
+    {
+      std::vector<unsigned int> hits_data;
+      std::vector<struct var_s> variant_list;
+      if (network_compressed or not network_stored) {
+        hits_data.resize(global_hits_alloc);
+        variant_list.resize(global_hits_alloc);
+      }
 
-          /* add subseeds on list to current swarm */
-          for(auto i = 0U; i < global_hits_count; ++i) {
-            add_amp_to_swarm(global_hits_v[i], ampinfo_v);
-          }
+      /* with --lazy-clustering, large generations are expanded by threads */
+      std::vector<struct expansion_s> expansions_v;
+      if (lazy and (parameters.opt_threads > 1)) {
+        expansions_v.resize(static_cast<uint64_t>(parameters.opt_threads));
+        for(auto & expansion : expansions_v) {
+          expansion.variant_list.resize(global_hits_alloc);
+          expansion.hits_data.resize(global_hits_alloc);
+        }
+        expansions = &expansions_v;
+      }
 
-          /* find later generation matches */
-          auto subseed = seed_info.next;
-          while(subseed != no_swarm)
+      progress_init("Clustering:       ", amplicons);
+      for(auto seed = 0U; seed < amplicons; ++seed)
+        {
+          if (ampinfo_v[seed].swarmid == no_swarm)
             {
-              /* process all subseeds of this generation */
-              global_hits_count = 0;
+              /* start a new swarm with a new initial seed */
+              auto const swarm = build_swarm(seed, swarmcount, ampinfo_v, global_hits_v,
+                                             variant_list, hits_data);
 
-              while(subseed != no_swarm)
+              if (swarmcount >= swarminfo_v.size())
                 {
-                  process_seed(subseed, ampinfo_v, global_hits_v, global_hits_count);
-                  subseed = ampinfo_v[subseed].next;
+                  /* allocate memory for more swarms... */
+                  // note: capacity doubles, as usual
+                  // 1,024 times struct size (so at least 40,960 new bytes reserved)
+                  swarminfo_v.resize(swarminfo_v.size() + one_kilobyte);
+                  swarminfo = swarminfo_v.data();
                 }
 
-              /* sort all of this generation */
-              std::sort(global_hits_v.begin(), global_hits_v.begin() + global_hits_count);
-
-              /* add them to the swarm */
-              for(auto i = 0U; i < global_hits_count; ++i) {
-                add_amp_to_swarm(global_hits_v[i], ampinfo_v);
-              }
+              swarminfo_v[swarmcount] = swarm;
 
-              /* start with most abundant amplicon of next generation */
-              if (global_hits_count != 0U) {
-                subseed = global_hits_v[0];
-              }
-              else {
-                subseed = no_swarm;
-              }
-            }
+              /* update overall stats */
+              largest = std::max(swarm.size, largest);
+              maxgen = std::max(swarm.maxgen, maxgen);
 
-          if (swarmcount >= swarminfo_v.size())
-            {
-              /* allocate memory for more swarms... */
-              // note: capacity doubles, as usual
-              // 1,024 times struct size (so at least 40,960 new bytes reserved)
-              swarminfo_v.resize(swarminfo_v.size() + one_kilobyte);
-              swarminfo = swarminfo_v.data();
+              ++swarmcount;
             }
-
-          auto & swarm_info = swarminfo_v[swarmcount];
-
-          swarm_info.seed = seed;
-          swarm_info.size = swarmsize;
-          swarm_info.mass = abundance_sum;
-          swarm_info.sumlen = swarm_sumlen;
-          swarm_info.singletons = singletons;
-          swarm_info.maxgen = swarm_maxgen;
-          swarm_info.last = current_swarm_tail;
-          swarm_info.attached = false;
-
-          /* update overall stats */
-          largest = std::max(swarmsize, largest);
-          maxgen = std::max(swarm_maxgen, maxgen);
-
-          ++swarmcount;
+          progress_update(seed + 1);
         }
-      progress_update(seed + 1);
+      progress_done(parameters);
+      expansions = nullptr;
     }
-  progress_done(parameters);
-
-  global_hits_data = nullptr;
 
   network_v.clear();
   network_v.shrink_to_fit();
+  network_bytes_v.clear();
+  network_bytes_v.shrink_to_fit();
+  network_offsets_v.clear();
+  network_offsets_v.shrink_to_fit();
 
   swarmcount_adjusted = swarmcount;
 
+  report_filter_stats(parameters, "Amplicon Bloom filter", amplicon_filter_counters);
+
   /* fastidious */
 
   if (parameters.opt_fastidious)
@@ -1334,140 +2842,155 @@ auto algo_d1_run(struct Parameters const & parameters) -> void
         }
       else
         {
-          /* m: total size of Bloom filter in bits */
-          /* k: number of hash functions (n_hash_functions) */
-          /* n: number of entries in the bloom filter */
-          /* here: k=11 and m/n=18, that is 16 bits/entry */
-
-          static constexpr auto microvariants = 7U;
-          static constexpr auto n_bits_in_a_byte = 8U;
-          static constexpr double hash_functions_per_bit {4.0 / 10};
-          static constexpr double natural_log_of_2 {0.693147181};  // C++26 refactoring: std::log(2.0)
-          static_assert(hash_functions_per_bit <= natural_log_of_2, "upper limit is log(2)");
-          assert(parameters.opt_bloom_bits <= std::numeric_limits<unsigned int>::max());
-          assert(parameters.opt_bloom_bits <= 64);  // larger than expected
-          assert(parameters.opt_bloom_bits >= 2);  // smaller than expected
-          auto bits = static_cast<uint64_t>(parameters.opt_bloom_bits);
-          auto bits_uint = static_cast<unsigned int>(parameters.opt_bloom_bits);  // avoid risky conversion warning: uint64 to double
-
-          // int64_t n_hash_functions = int(bits * std::log(2.0));    /* 16 bits -> 11 hash functions */
-          // auto n_hash_functions = unsigned int(hash_functions_per_bit * bits); /* 6 */
-          auto n_hash_functions = std::max(static_cast<unsigned int>(hash_functions_per_bit * bits_uint), 1U);
-
-          uint64_t bloom_length_in_bits = nucleotides_in_small_clusters * microvariants * bits;
-
-          const uint64_t memtotal = arch_get_memtotal();
-          const uint64_t memused = arch_get_memused();
-
-          if (parameters.opt_ceiling != 0)
+          const auto exact_index =
+            (parameters.opt_fastidious_index == Fastidious_index::exact) or
+            (parameters.opt_fastidious_index == Fastidious_index::deletion);
+          const auto fuse_filter =
+            (parameters.opt_fastidious_index == Fastidious_index::fuse);
+          light_halves =
+            (parameters.opt_fastidious_index == Fastidious_index::deletion);
+
+          /* light amplicons, from least to most abundant */
+          std::vector<unsigned int> light_amplicons_v;
+          light_amplicons_v.reserve(amplicons_in_small_clusters);
+          for(auto rank = 0U; rank < amplicons; ++rank)
             {
-              if (static_cast<uint64_t>(parameters.opt_ceiling) * one_megabyte < memused)
-                {
-                  fatal(error_prefix, "Memory ceiling for Bloom filter is too low.");
-                }
-              assert(memused < one_megabyte * static_cast<uint64_t>(parameters.opt_ceiling));
-              const uint64_t memrest
-                = one_megabyte * static_cast<uint64_t>(parameters.opt_ceiling) - memused;
-              auto const new_bits = n_bits_in_a_byte * memrest / (microvariants * nucleotides_in_small_clusters);
-              if (new_bits < bits)
-                {
-                  if (new_bits < 2) {
-                    fatal(error_prefix, "Insufficient memory remaining for Bloom filter.");
-                  }
-                  std::fprintf(parameters.logfile, "Reducing memory used for Bloom filter due to --ceiling option.\n");
-                  bits = new_bits;
-                  bits_uint = static_cast<unsigned int>(new_bits);
-                  n_hash_functions = std::max(static_cast<unsigned int>(hash_functions_per_bit * bits_uint), 1U);
-                  bloom_length_in_bits = nucleotides_in_small_clusters * microvariants * bits;
-                }
+              const auto amp = amplicons - 1 - rank;
+              if (swarminfo_v[ampinfo_v[amp].swarmid].mass < static_cast<uint64_t>(opt_boundary)) {
+                light_amplicons_v.push_back(amp);
+              }
             }
 
-          static constexpr uint64_t min_bloom_length_in_bits {64};  // at least 64 bits
-          bloom_length_in_bits = std::max(bloom_length_in_bits, min_bloom_length_in_bits);
+          std::vector<std::atomic<unsigned int>> graft_parents_v(amplicons);
+          for(auto & graft_parent : graft_parents_v) {
+            graft_parent.store(no_swarm, std::memory_order_relaxed);
+          }
+          graft_parents = &graft_parents_v;
+
+          heavy_variants = 0;
 
-          if (memused + bloom_length_in_bits / n_bits_in_a_byte > memtotal)
+          const auto pass_ends = fastidious_passes(parameters, light_amplicons_v);
+          if (pass_ends.size() > 1)
             {
-              std::fprintf(parameters.logfile, "WARNING: Memory usage will probably exceed total amount of memory available.\n");
-              std::fprintf(parameters.logfile, "Try to reduce memory footprint using the --bloom-bits or --ceiling options.\n");
+              std::fprintf(parameters.logfile,
+                           "Splitting light swarm amplicons in %zu passes due to --ceiling option.\n",
+                           pass_ends.size());
             }
 
-          std::fprintf(parameters.logfile,
-                       "Bloom filter: bits=%" PRIu64 ", m=%" PRIu64 ", k=%u, size=%.1fMB\n",
-                       bits, bloom_length_in_bits, n_hash_functions, static_cast<double>(bloom_length_in_bits) / (n_bits_in_a_byte * one_megabyte));
-
-
-          // bloom_length is in bits (divide by 8 to get bytes)
-          // bloom_length is guaranteed to be at least 64 (see code above)
-          assert(bloom_length_in_bits != 0);  // safeguard for future changes
-          assert(bloom_length_in_bits >= 64);
-          const uint64_t n_bytes = ((bloom_length_in_bits - 1) / n_bits_in_a_byte) + 1;
-          struct bloomflex_s bloomflex_filter;
-          bloom_f = bloomflex_init(n_bytes, n_hash_functions, bloomflex_filter);
-
+          uint64_t pass_start {0};
+          for(auto const pass_end : pass_ends)
+            {
+              const uint64_t pass_amplicons = pass_end - pass_start;
+              uint64_t pass_nucleotides {0};
+              for(auto i = pass_start; i < pass_end; ++i) {
+                pass_nucleotides += db_getsequencelen(light_amplicons_v[i]);
+              }
 
-          /* Empty the old hash and bloom filter
-             before we reinsert only the light swarm amplicons */
+              struct bloomflex_s bloomflex_filter;
+              struct varindex_s varindex;
+              struct fusefilter_s fusefilter;
+              std::vector<uint64_t> light_keys_v;
+              if (exact_index) {
+                light_index = fastidious_index_init(parameters, pass_nucleotides,
+                                                    pass_amplicons, varindex);
+              }
+              else if (fuse_filter) {
+                light_keys = fastidious_fuse_init(parameters, pass_nucleotides,
+                                                  pass_amplicons, light_keys_v);
+              }
+              else {
+                uint64_t pass_variants {0};
+                if (parameters.opt_bloom_auto) {
+                  for(auto i = pass_start; i < pass_end; ++i) {
+                    pass_variants += count_variants(db_getsequence(light_amplicons_v[i]),
+                                                    db_getsequencelen(light_amplicons_v[i]));
+                  }
+                }
+                bloom_f = fastidious_bloom_init(parameters, pass_nucleotides,
+                                                pass_variants, bloomflex_filter);
+              }
 
-          std::fill(hash_occupied_v.begin(), hash_occupied_v.end(), 0U);
-          bloom_zap(bloom_filter);
 
-          progress_init("Adding light swarm amplicons to Bloom filter",
-                        amplicons_in_small_clusters);
+              /* Empty the old hash and bloom filter
+                 before we reinsert only the light swarm amplicons */
 
-          /* process amplicons in order from least to most abundant */
-          /* but stop when all amplicons in small clusters are processed */
+              hash_zap();
+              bloom_zap(bloom_filter);
 
-          light_variants = 0;
+              progress_init(exact_index ?
+                            "Adding light swarm amplicons to variant index" :
+                            (fuse_filter ?
+                             "Adding light swarm amplicons to binary fuse filter" :
+                             "Adding light swarm amplicons to Bloom filter"),
+                            pass_amplicons);
 
-          pthread_mutex_init(&light_mutex, nullptr);
-          light_progress = 0;
-          light_amplicon_count = amplicons_in_small_clusters;
-          light_amplicon = amplicons - 1;
-          {
-            assert(parameters.opt_threads <= std::numeric_limits<int>::max());
-            // refactoring C++14: use std::make_unique
-            std::unique_ptr<ThreadRunner> light_tr (new ThreadRunner(static_cast<int>(parameters.opt_threads), mark_light_thread));
-            light_tr->run();
-          }
-          pthread_mutex_destroy(&light_mutex);
+              light_variants = 0;
 
-          progress_done(parameters);
+              light_amplicons = std::next(light_amplicons_v.data(),
+                                          static_cast<std::ptrdiff_t>(pass_start));
+              light_amplicon_count = pass_amplicons;
+              {
+                ChunkScheduler scheduler(pass_amplicons, static_cast<uint64_t>(parameters.opt_threads),
+                                         1, light_chunk_max);
+                light_scheduler = &scheduler;
+                thread_pool->run(mark_light_thread);
+                light_scheduler = nullptr;
+              }
+              light_amplicons = nullptr;
 
-          std::fprintf(parameters.logfile,
-                       "Generated %" PRIu64 " variants from light swarms\n",
-                       light_variants);
+              progress_done(parameters);
 
-          progress_init("Checking heavy swarm amplicons against Bloom filter",
-                        amplicons_in_large_clusters);
+              std::fprintf(parameters.logfile,
+                           "Generated %" PRIu64 " variants from light swarms\n",
+                           light_variants.load());
 
-          /* process amplicons in order from most to least abundant */
-          /* but stop when all amplicons in large clusters are processed */
+              if (fuse_filter)
+                {
+                  fuse_f = fastidious_fuse_build(parameters, light_keys_v, fusefilter);
+                  light_keys = nullptr;
+                }
 
-          pthread_mutex_init(&graft_mutex, nullptr);
+              progress_init(exact_index ?
+                            "Checking heavy swarm amplicons against variant index" :
+                            (fuse_filter ?
+                             "Checking heavy swarm amplicons against binary fuse filter" :
+                             "Checking heavy swarm amplicons against Bloom filter"),
+                            amplicons_in_large_clusters);
 
-          heavy_variants = 0;
+              /* process amplicons in order from most to least abundant */
+              /* but stop when all amplicons in large clusters are processed */
 
-          pthread_mutex_init(&heavy_mutex, nullptr);
-          heavy_progress = 0;
-          heavy_amplicon_count = amplicons_in_large_clusters;
-          heavy_amplicon = 0;
-          {
-            assert(parameters.opt_threads <= std::numeric_limits<int>::max());
-            // refactoring C++14: use std::make_unique
-            std::unique_ptr<ThreadRunner> heavy_tr (new ThreadRunner(static_cast<int>(parameters.opt_threads), check_heavy_thread));
-            heavy_tr->run();
-          }
+              heavy_amplicon_count = amplicons_in_large_clusters;
+              {
+                ChunkScheduler scheduler(amplicons, static_cast<uint64_t>(parameters.opt_threads),
+                                         1, heavy_chunk_max);
+                heavy_scheduler = &scheduler;
+                thread_pool->run(check_heavy_thread);
+                heavy_scheduler = nullptr;
+              }
 
-          pthread_mutex_destroy(&heavy_mutex);
+              progress_done(parameters);
 
-          progress_done(parameters);
+              bloomflex_exit(bloomflex_filter);
+              varindex_exit(varindex);
+              fusefilter_exit(fusefilter);
+              bloom_f = nullptr;
+              light_index = nullptr;
+              fuse_f = nullptr;
 
-          bloomflex_exit(bloomflex_filter);
+              pass_start = pass_end;
+            }
+          light_halves = false;
 
-          pthread_mutex_destroy(&graft_mutex);
+          graft_parents = nullptr;
+          for(auto amp = 0U; amp < amplicons; ++amp) {
+            ampinfo_v[amp].graft_cand = graft_parents_v[amp].load(std::memory_order_relaxed);
+          }
 
-          std::fprintf(parameters.logfile, "Heavy variants: %" PRIu64 "\n", heavy_variants);
-          std::fprintf(parameters.logfile, "Got %" PRId64 " graft candidates\n", graft_candidates);
+          std::fprintf(parameters.logfile, "Heavy variants: %" PRIu64 "\n", heavy_variants.load());
+          report_filter_stats(parameters, fuse_filter ? "Binary fuse filter" : "Bloom filter",
+                              light_filter_counters);
+          std::fprintf(parameters.logfile, "Got %" PRId64 " graft candidates\n", graft_candidates.load());
           const unsigned int grafts = attach_candidates(parameters, amplicons, ampinfo_v, swarminfo_v);
           std::fprintf(parameters.logfile, "Made %u grafts\n", grafts);
           std::fprintf(parameters.logfile, "\n");
@@ -0,0 +1,89 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+
+#ifdef __x86_64__
+#ifdef __AVX2__
+
+#include <immintrin.h>
+#include "bloompat.h"
+#include <cstdint>  // uint64_t
+
+
+/*
+  AVX2 specific code for x86-64
+
+  Only include if __AVX2__ is defined, which is done by the
+  gcc compiler when the -mavx2 option or similar is given.
+
+  This code requires the 64-bit gather instructions (VPGATHERQQ)
+  available starting with the Haswell architecture in 2013.
+*/
+
+auto bloom_get_batch_avx2(struct bloom_s * bloom_filter,
+                          uint64_t const * hashes,
+                          unsigned int const count) -> uint64_t
+{
+  /* Query four hashes at a time: both the bitmap words and the bit
+     patterns are fetched with gathers, so that the cache misses of
+     the four lanes overlap. Bit i of the result is set if hash i
+     may be present. */
+
+  static constexpr unsigned int lanes {4};
+  static constexpr int scale {sizeof(uint64_t)};
+
+  const auto position_mask = _mm256_set1_epi64x(static_cast<long long>(bloom_filter->mask));
+  const auto pattern_mask = _mm256_set1_epi64x(bloom_pattern_mask);
+  const auto zero = _mm256_setzero_si256();
+  auto const * bitmap = reinterpret_cast<long long const *>(bloom_filter->bitmap);
+  auto const * patterns = reinterpret_cast<long long const *>(bloom_filter->patterns.data());
+
+  uint64_t result {0};
+  auto i = 0U;
+  for(; i + lanes <= count; i += lanes)
+    {
+      const auto hash = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(hashes + i));
+      const auto position = _mm256_and_si256(_mm256_srli_epi64(hash, bloom_pattern_shift),
+                                             position_mask);
+      const auto words = _mm256_i64gather_epi64(bitmap, position, scale);
+      const auto pattern = _mm256_i64gather_epi64(patterns,
+                                                  _mm256_and_si256(hash, pattern_mask),
+                                                  scale);
+      const auto present = _mm256_cmpeq_epi64(_mm256_and_si256(words, pattern), zero);
+      const auto bits = _mm256_movemask_pd(_mm256_castsi256_pd(present));
+      result |= static_cast<uint64_t>(bits) << i;
+    }
+
+  for(; i < count; ++i) {
+    if (bloom_get(bloom_filter, hashes[i])) {
+      result |= uint64_t{1} << i;
+    }
+  }
+
+  return result;
+}
+
+#else
+#error __AVX2__ not defined
+#endif
+#endif
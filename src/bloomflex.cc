@@ -32,6 +32,7 @@
 */
 
 #include "bloomflex.h"
+#include "utils/first_touch.h"
 #include "utils/pseudo_rng.h"
 #include <cassert>
 #include <cstddef>  // std::ptrdiff_t
@@ -70,6 +71,30 @@ auto bloomflex_get(struct bloomflex_s * bloom_filter, uint64_t hash) -> bool
 }
 
 
+auto bloomflex_get_batch(struct bloomflex_s * bloom_filter,
+                         uint64_t const * hashes,
+                         unsigned int const count) -> uint64_t
+{
+  /* Query up to 64 hashes at once; bit i of the result is set if
+     hash i may be present. The bitmap size is not a power of two, so
+     the positions are computed lane by lane, but the words are all
+     prefetched before any of them is tested. */
+  assert(count <= bloomflex_batch_max);
+
+  for(auto i = 0U; i < count; ++i) {
+    __builtin_prefetch(bloomflex_adr(bloom_filter, hashes[i]));
+  }
+
+  uint64_t result {0};
+  for(auto i = 0U; i < count; ++i) {
+    if (bloomflex_get(bloom_filter, hashes[i])) {
+      result |= uint64_t{1} << i;
+    }
+  }
+  return result;
+}
+
+
 auto bloomflex_patterns_generate(struct bloomflex_s & bloom_filter) -> void
 {
   static constexpr auto max_range = 63U;  // i & max_range = cap values to 63 max
@@ -95,7 +120,7 @@ auto bloomflex_init(const uint64_t size, const unsigned int n_hash_functions,
 
   static constexpr unsigned int multiplier {16};  // multiply by 65,536
   static constexpr unsigned int divider {3};  // divide by 8
-  static constexpr auto uint64_max = std::numeric_limits<uint64_t>::max();
+  static constexpr unsigned char all_bits_set {0xFF};
 
   bloom_filter.size = size >> divider;  // divide by 8 to get number of uint64
 
@@ -108,8 +133,9 @@ auto bloomflex_init(const uint64_t size, const unsigned int n_hash_functions,
   bloom_filter.patterns = bloom_filter.patterns_v.data();
   bloomflex_patterns_generate(bloom_filter);
 
-  bloom_filter.bitmap_v.resize(bloom_filter.size, uint64_max);
-  bloom_filter.bitmap = bloom_filter.bitmap_v.data();
+  bloom_filter.bitmap_p.reset(new uint64_t[bloom_filter.size]);
+  bloom_filter.bitmap = bloom_filter.bitmap_p.get();
+  first_touch_fill(bloom_filter.bitmap, bloom_filter.size << divider, all_bits_set);
 
   return &bloom_filter;
 }
@@ -22,8 +22,10 @@
 */
 
 #include <cstdint>  // uint64_t
+#include <memory>  // std::unique_ptr
 #include <vector>
 
+constexpr unsigned int bloomflex_batch_max {64};  // one result bit per hash
 
 struct bloomflex_s
 {
@@ -32,7 +34,7 @@ struct bloomflex_s
   uint64_t pattern_count = 0;
   uint64_t pattern_mask = 0;
   uint64_t pattern_k = 0;
-  std::vector<uint64_t> bitmap_v;
+  std::unique_ptr<uint64_t[]> bitmap_p;  // see utils/first_touch.h
   uint64_t * bitmap = nullptr;
   std::vector<uint64_t> patterns_v;
   uint64_t * patterns = nullptr;
@@ -50,3 +52,7 @@ auto bloomflex_pat(struct bloomflex_s * bloom_filter, uint64_t hash) -> uint64_t
 auto bloomflex_set(struct bloomflex_s * bloom_filter, uint64_t hash) -> void;
 
 auto bloomflex_get(struct bloomflex_s * bloom_filter, uint64_t hash) -> bool;
+
+auto bloomflex_get_batch(struct bloomflex_s * bloom_filter,
+                         uint64_t const * hashes,
+                         unsigned int count) -> uint64_t;
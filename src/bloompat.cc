@@ -32,8 +32,13 @@
 */
 
 #include "bloompat.h"
+#include "utils/first_touch.h"
 #include "utils/pseudo_rng.h"
-#include <algorithm>  // std::max(), std::fill()
+#ifdef __x86_64__
+#include "avx2.h"
+#include "utils/x86_cpu_feature_avx2.h"
+#endif
+#include <algorithm>  // std::max()
 #include <cassert>
 #include <cstddef>  // std::ptrdiff_t
 #include <cstdint>  // uint64_t, uint8_t
@@ -70,6 +75,35 @@ auto bloom_get(struct bloom_s * bloom_filter, uint64_t hash) -> bool
   return (*bloom_adr(bloom_filter, hash) & bloom_pat(bloom_filter, hash)) == 0U;
 }
 
+// used in algod1.cc
+auto bloom_get_batch(struct bloom_s * bloom_filter,
+                     uint64_t const * hashes,
+                     unsigned int const count) -> uint64_t
+{
+  /* Query up to 64 hashes at once; bit i of the result is set if
+     hash i may be present. The bitmap words are all requested before
+     any of them is tested, so that their cache misses overlap. */
+  assert(count <= bloom_batch_max);
+
+#ifdef __x86_64__
+  if (avx2_present != 0) {
+    return bloom_get_batch_avx2(bloom_filter, hashes, count);
+  }
+#endif
+
+  for(auto i = 0U; i < count; ++i) {
+    __builtin_prefetch(bloom_adr(bloom_filter, hashes[i]));
+  }
+
+  uint64_t result {0};
+  for(auto i = 0U; i < count; ++i) {
+    if (bloom_get(bloom_filter, hashes[i])) {
+      result |= uint64_t{1} << i;
+    }
+  }
+  return result;
+}
+
 
 auto bloom_patterns_generate(struct bloom_s & bloom_filter) -> void
 {
@@ -92,8 +126,8 @@ auto bloom_patterns_generate(struct bloom_s & bloom_filter) -> void
 
 auto bloom_zap(struct bloom_s & bloom_filter) -> void
 {
-  static constexpr auto uint64_max = std::numeric_limits<uint64_t>::max();
-  std::fill(bloom_filter.bitmap_v.begin(), bloom_filter.bitmap_v.end(), uint64_max);
+  static constexpr unsigned char all_bits_set {0xFF};
+  parallel_fill(bloom_filter.bitmap, bloom_filter.size, all_bits_set);
 }
 
 
@@ -103,7 +137,7 @@ auto bloom_init(uint64_t size, struct bloom_s & bloom_filter) -> struct bloom_s
   // at least 8
   // assert(std::has_single_bit(size));  // C++20 refactoring: is power of 2?
   static constexpr uint64_t bytes_per_uint64 {8};
-  static constexpr auto uint64_max = std::numeric_limits<uint64_t>::max();
+  static constexpr unsigned char all_bits_set {0xFF};
 
   size = std::max(size, bytes_per_uint64);
 
@@ -111,8 +145,9 @@ auto bloom_init(uint64_t size, struct bloom_s & bloom_filter) -> struct bloom_s
 
   bloom_filter.mask = (size >> 3U) - 1;
 
-  bloom_filter.bitmap_v.resize(size / bytes_per_uint64, uint64_max);
-  bloom_filter.bitmap = bloom_filter.bitmap_v.data();
+  bloom_filter.bitmap_p.reset(new uint64_t[size / bytes_per_uint64]);
+  bloom_filter.bitmap = bloom_filter.bitmap_p.get();
+  first_touch_fill(bloom_filter.bitmap, size, all_bits_set);
 
   bloom_patterns_generate(bloom_filter);
 
@@ -23,17 +23,18 @@
 
 #include <array>
 #include <cstdint>  // uint64_t
-#include <vector>
+#include <memory>  // std::unique_ptr
 
 constexpr unsigned int bloom_pattern_shift {10};
 constexpr unsigned int bloom_pattern_count {1U << bloom_pattern_shift};
 constexpr unsigned int bloom_pattern_mask {bloom_pattern_count - 1};
+constexpr unsigned int bloom_batch_max {64};  // one result bit per hash
 
 struct bloom_s
 {
   uint64_t size = 0;
   uint64_t mask = 0;
-  std::vector<uint64_t> bitmap_v;
+  std::unique_ptr<uint64_t[]> bitmap_p;  // see utils/first_touch.h
   uint64_t * bitmap = nullptr;
   std::array<uint64_t, bloom_pattern_count> patterns {{}};
 };
@@ -49,3 +50,8 @@ auto bloom_set(struct bloom_s * bloom_filter, uint64_t hash) -> void;
 
 // used in algod1.cc
 auto bloom_get(struct bloom_s * bloom_filter, uint64_t hash) -> bool;
+
+// used in algod1.cc
+auto bloom_get_batch(struct bloom_s * bloom_filter,
+                     uint64_t const * hashes,
+                     unsigned int count) -> uint64_t;
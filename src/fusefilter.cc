@@ -0,0 +1,353 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+/*
+  Binary fuse filter as described in
+  Graf TM, Lemire D (2022)
+  Binary Fuse Filters: Fast and Smaller Than Xor Filters
+  Journal of Experimental Algorithmics, 27, 1-15
+  https://doi.org/10.1145/3510449
+*/
+
+#include "fusefilter.h"
+#include "utils/pseudo_rng.h"
+#include <algorithm>  // std::sort, std::max, std::min
+#include <array>
+#include <cassert>
+#include <cmath>  // std::log, std::floor, std::round
+#include <cstddef>  // std::ptrdiff_t
+#include <cstdint>  // uint64_t
+#include <iterator>  // std::next
+#include <limits>
+#include <vector>
+
+
+constexpr auto arity = 3U;  // slots per key
+constexpr unsigned int max_attempts {100};
+constexpr uint64_t max_segment_length {1ULL << 18U};
+
+
+auto fusefilter_mix(uint64_t const key, uint64_t const salt) -> uint64_t
+{
+  /* finalizer of MurmurHash3 (bijective) */
+  static constexpr uint64_t multiplier1 {0xFF51AFD7ED558CCD};
+  static constexpr uint64_t multiplier2 {0xC4CEB9FE1A85EC53};
+  static constexpr auto shift = 33U;
+  auto hash = key + salt;
+  hash ^= hash >> shift;
+  hash *= multiplier1;
+  hash ^= hash >> shift;
+  hash *= multiplier2;
+  hash ^= hash >> shift;
+  return hash;
+}
+
+
+auto fusefilter_fingerprint(uint64_t const hash) -> unsigned char
+{
+  static constexpr auto shift = 32U;
+  static constexpr uint64_t byte_mask {0xFF};
+  return static_cast<unsigned char>((hash ^ (hash >> shift)) & byte_mask);
+}
+
+
+auto fusefilter_slots(struct fusefilter_s const * filter,
+                      uint64_t const hash) -> std::array<uint64_t, arity + 2>
+{
+  /* the three slots of a key, in consecutive segments; the first two
+     are repeated at the end to simplify modulo 3 indexing */
+  static constexpr auto shift = 18U;
+  static constexpr auto half = 32U;
+  static constexpr uint64_t lower_half {0xFFFFFFFF};
+  /* upper 64 bits of hash * segment_count_length (less than 2^32) */
+  const auto slot0 =
+    (((hash >> half) * filter->segment_count_length) +
+     (((hash & lower_half) * filter->segment_count_length) >> half)) >> half;
+  auto slot1 = slot0 + filter->segment_length;
+  auto slot2 = slot1 + filter->segment_length;
+  slot1 ^= (hash >> shift) & filter->segment_length_mask;
+  slot2 ^= hash & filter->segment_length_mask;
+  return {slot0, slot1, slot2, slot0, slot1};
+}
+
+
+auto fusefilter_geometry(uint64_t const size,
+                         struct fusefilter_s & filter) -> void
+{
+  /* segment length and count for arity 3 (see the reference
+     implementation) */
+  static constexpr double segment_log_base {3.33};
+  static constexpr double segment_log_offset {2.25};
+  static constexpr double min_size_factor {1.125};
+  static constexpr double size_factor_offset {0.875};
+  static constexpr double size_factor_weight {0.25};
+  static constexpr double reference_size {1000000.0};
+  static constexpr uint64_t min_segment_length {4};
+
+  if (size <= 1)
+    {
+      filter.segment_length = min_segment_length;
+    }
+  else
+    {
+      const auto exponent = static_cast<unsigned int>(
+        std::floor((std::log(static_cast<double>(size)) / std::log(segment_log_base)) +
+                   segment_log_offset));
+      filter.segment_length = std::min(uint64_t{1} << exponent, max_segment_length);
+    }
+  filter.segment_length_mask = filter.segment_length - 1;
+
+  const auto size_factor = (size <= 1) ? 0.0 :
+    std::max(min_size_factor,
+             size_factor_offset + (size_factor_weight * std::log(reference_size) /
+                                   std::log(static_cast<double>(size))));
+  const auto capacity =
+    static_cast<uint64_t>(std::round(static_cast<double>(size) * size_factor));
+  const auto segments = (capacity + filter.segment_length - 1) / filter.segment_length;
+  filter.segment_count = (segments > arity - 1) ? segments - (arity - 1) : 1;
+  filter.array_length = (filter.segment_count + arity - 1) * filter.segment_length;
+  filter.segment_count_length = filter.segment_count * filter.segment_length;
+}
+
+
+auto fusefilter_memory(uint64_t const keys) -> uint64_t
+{
+  /* peak number of bytes used while building a filter: sorted keys,
+     peeling order and slot counters, plus the filter itself */
+  struct fusefilter_s filter;
+  fusefilter_geometry(keys, filter);
+  return keys * (sizeof(uint64_t) + sizeof(unsigned char)) +
+    filter.array_length * (sizeof(uint64_t) + sizeof(unsigned int) +
+                           2 * sizeof(unsigned char));
+}
+
+
+auto fusefilter_init(std::vector<uint64_t> const & keys,
+                     struct fusefilter_s & filter) -> struct fusefilter_s *
+{
+  static constexpr auto count_unit = 4U;  /* two lower bits store slot ranks */
+  static constexpr auto rank_mask = 3U;
+  static constexpr auto bits_per_uint64 = 64U;
+
+  fusefilter_geometry(keys.size(), filter);
+  assert(filter.array_length <= std::numeric_limits<unsigned int>::max());
+  std::vector<unsigned char> fingerprints_v(filter.array_length, 0);
+
+  /* keys are bucket sorted by the upper bits of their hash, in small
+     blocks, so that duplicates can be removed cheaply and slots are
+     visited in order */
+  static constexpr uint64_t block_keys {1024};  // average block size
+  auto block_bits = 1U;
+  while ((uint64_t{1} << block_bits) < keys.size() / block_keys) {
+    ++block_bits;
+  }
+  const auto block_count = uint64_t{1} << block_bits;
+  const auto block_shift = bits_per_uint64 - block_bits;
+
+  std::vector<uint64_t> sorted_v(keys.size());
+  std::vector<uint64_t> block_start_v(block_count + 1);
+  std::vector<unsigned char> ranks_v(keys.size());
+  std::vector<uint64_t> xors_v(filter.array_length);
+  std::vector<unsigned char> counts_v(filter.array_length);
+  std::vector<unsigned int> alone_v(filter.array_length);
+
+  auto success = false;
+  uint64_t size {0};
+  for(auto attempt = 0U; (attempt < max_attempts) and (not success); ++attempt)
+    {
+      filter.seed = rand_64();
+
+      /* counting sort of the hashes by block */
+      std::fill(block_start_v.begin(), block_start_v.end(), 0);
+      for(auto const key : keys) {
+        ++block_start_v[(fusefilter_mix(key, filter.seed) >> block_shift) + 1];
+      }
+      for(auto block = 0ULL; block < block_count; ++block) {
+        block_start_v[block + 1] += block_start_v[block];
+      }
+      for(auto const key : keys) {
+        const auto hash = fusefilter_mix(key, filter.seed);
+        auto & position = block_start_v[hash >> block_shift];
+        sorted_v[position] = hash;
+        ++position;
+      }
+
+      /* block_start_v now holds block ends; sort each block and drop
+         duplicated keys (mixing is bijective, equal hashes are equal keys) */
+      size = 0;
+      uint64_t block_begin {0};
+      for(auto block = 0ULL; block < block_count; ++block)
+        {
+          const auto block_end = block_start_v[block];
+          auto first = std::next(sorted_v.begin(), static_cast<std::ptrdiff_t>(block_begin));
+          auto last = std::next(sorted_v.begin(), static_cast<std::ptrdiff_t>(block_end));
+          std::sort(first, last);
+          for(auto i = block_begin; i < block_end; ++i) {
+            if ((i == block_begin) or (sorted_v[i] != sorted_v[i - 1])) {
+              sorted_v[size] = sorted_v[i];
+              ++size;
+            }
+          }
+          block_begin = block_end;
+        }
+
+      /* count keys per slot, xor their hashes, and xor the rank of
+         the slot (0, 1 or 2) in the two lower bits of the counter */
+      std::fill(counts_v.begin(), counts_v.end(), 0);
+      std::fill(xors_v.begin(), xors_v.end(), 0);
+      auto overflow = false;
+      for(auto i = 0ULL; i < size; ++i)
+        {
+          const auto hash = sorted_v[i];
+          const auto slots = fusefilter_slots(&filter, hash);
+          for(auto rank = 0U; rank < arity; ++rank)
+            {
+              auto & count = counts_v[slots[rank]];
+              count = static_cast<unsigned char>((count + count_unit) ^ rank);
+              xors_v[slots[rank]] ^= hash;
+              overflow = overflow or (count < count_unit);
+            }
+        }
+      if (overflow) {
+        continue;
+      }
+
+      /* peel slots holding a single key; the peeling order is stored
+         in sorted_v (the hashes are kept in xors_v meanwhile) */
+      uint64_t queue_size {0};
+      for(auto slot = 0ULL; slot < filter.array_length; ++slot)
+        {
+          alone_v[queue_size] = static_cast<unsigned int>(slot);
+          if ((counts_v[slot] / count_unit) == 1) {
+            ++queue_size;
+          }
+        }
+
+      uint64_t stack_size {0};
+      while (queue_size > 0)
+        {
+          --queue_size;
+          const auto slot = alone_v[queue_size];
+          if ((counts_v[slot] / count_unit) != 1) {
+            continue;
+          }
+          const auto hash = xors_v[slot];
+          const auto found = counts_v[slot] & rank_mask;
+          ranks_v[stack_size] = static_cast<unsigned char>(found);
+          sorted_v[stack_size] = hash;
+          ++stack_size;
+
+          const auto slots = fusefilter_slots(&filter, hash);
+          for(auto next = 1U; next < arity; ++next)
+            {
+              const auto other = slots[found + next];
+              alone_v[queue_size] = static_cast<unsigned int>(other);
+              if ((counts_v[other] / count_unit) == 2) {
+                ++queue_size;
+              }
+              counts_v[other] = static_cast<unsigned char>(
+                (counts_v[other] - count_unit) ^ ((found + next) % arity));
+              xors_v[other] ^= hash;
+            }
+        }
+
+      success = (stack_size == size);
+    }
+
+  if (not success) {
+    return nullptr;
+  }
+
+  /* assign fingerprints in reverse peeling order */
+  for(auto i = size; i > 0; --i)
+    {
+      const auto hash = sorted_v[i - 1];
+      const auto found = ranks_v[i - 1];
+      const auto slots = fusefilter_slots(&filter, hash);
+      fingerprints_v[slots[found]] = static_cast<unsigned char>(
+        fusefilter_fingerprint(hash) ^
+        fingerprints_v[slots[found + 1]] ^
+        fingerprints_v[slots[found + 2]]);
+    }
+
+  filter.fingerprints_v.swap(fingerprints_v);
+  return &filter;
+}
+
+
+auto fusefilter_exit(struct fusefilter_s & filter) -> void
+{
+  // release memory
+  filter.fingerprints_v.clear();
+  filter.fingerprints_v.shrink_to_fit();
+}
+
+
+auto fusefilter_size(struct fusefilter_s const * filter) -> uint64_t
+{
+  /* in bytes */
+  return filter->fingerprints_v.size();
+}
+
+
+auto fusefilter_get(struct fusefilter_s const * filter, uint64_t const hash) -> bool
+{
+  const auto mixed = fusefilter_mix(hash, filter->seed);
+  const auto slots = fusefilter_slots(filter, mixed);
+  return (fusefilter_fingerprint(mixed) ^
+          filter->fingerprints_v[slots[0]] ^
+          filter->fingerprints_v[slots[1]] ^
+          filter->fingerprints_v[slots[2]]) == 0;
+}
+
+
+auto fusefilter_get_batch(struct fusefilter_s const * filter,
+                          uint64_t const * hashes,
+                          unsigned int const count) -> uint64_t
+{
+  /* Query up to 64 hashes at once; bit i of the result is set if
+     hash i may be present. The three slots of every hash are
+     prefetched before any fingerprint is tested. */
+  assert(count <= fusefilter_batch_max);
+
+  std::array<uint64_t, fusefilter_batch_max> mixed {{}};
+  for(auto i = 0U; i < count; ++i) {
+    mixed[i] = fusefilter_mix(hashes[i], filter->seed);
+    const auto slots = fusefilter_slots(filter, mixed[i]);
+    for(auto j = 0U; j < arity; ++j) {
+      __builtin_prefetch(&filter->fingerprints_v[slots[j]]);
+    }
+  }
+
+  uint64_t result {0};
+  for(auto i = 0U; i < count; ++i) {
+    const auto slots = fusefilter_slots(filter, mixed[i]);
+    if ((fusefilter_fingerprint(mixed[i]) ^
+         filter->fingerprints_v[slots[0]] ^
+         filter->fingerprints_v[slots[1]] ^
+         filter->fingerprints_v[slots[2]]) == 0) {
+      result |= uint64_t{1} << i;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,62 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include <cstdint>  // uint64_t
+#include <vector>
+
+constexpr unsigned int fusefilter_batch_max {64};  // one result bit per hash
+
+/*
+  Static binary fuse filter with 8-bit fingerprints (fastidious): an
+  xor filter variant where each key is mapped to three slots in
+  consecutive segments, and the xor of the three slots is the
+  fingerprint of the key. It uses about 9 bits per key for a false
+  positive rate of 1/256. The filter is built once from the complete
+  list of keys (duplicates are allowed), and cannot be updated.
+*/
+
+struct fusefilter_s
+{
+  uint64_t seed = 0;
+  uint64_t segment_length = 0;
+  uint64_t segment_length_mask = 0;
+  uint64_t segment_count = 0;
+  uint64_t segment_count_length = 0;
+  uint64_t array_length = 0;
+  std::vector<unsigned char> fingerprints_v;
+};
+
+auto fusefilter_init(std::vector<uint64_t> const & keys,
+                     struct fusefilter_s & filter) -> struct fusefilter_s *;
+
+auto fusefilter_exit(struct fusefilter_s & filter) -> void;
+
+auto fusefilter_size(struct fusefilter_s const * filter) -> uint64_t;
+
+auto fusefilter_memory(uint64_t keys) -> uint64_t;
+
+auto fusefilter_get(struct fusefilter_s const * filter, uint64_t hash) -> bool;
+
+auto fusefilter_get_batch(struct fusefilter_s const * filter,
+                          uint64_t const * hashes,
+                          unsigned int count) -> uint64_t;
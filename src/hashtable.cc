@@ -21,13 +21,17 @@
     PO Box 1080 Blindern, NO-0316 Oslo, Norway
 */
 
+#include <algorithm>  // std::equal()
 #include <cassert>
 #include <cstddef>  // std::ptrdiff_t
 #include <cstdint>
 #include <iterator>  // std::next
-#include <vector>
+#include <memory>  // std::unique_ptr
+#include "db.h"
 #include "hashtable.h"
+#include "utils/first_touch.h"
 #include "utils/hashtable_size.h"
+#include "utils/nt_codec.h"
 
 #ifndef NDEBUG
 #include <limits>
@@ -36,9 +40,10 @@ constexpr auto max_ptrdiff = std::numeric_limits<std::ptrdiff_t>::max();
 #endif
 
 // refactoring: all functions and globals are only used in
-// algod1.cc. It should be possible to pass references to a struct and
+// algod1.cc and algo.cc. It should be possible to pass references to a struct and
 // to vectors, and to eliminate all globals.
 uint64_t hash_mask {0};
+uint64_t hash_occupied_size {0};  // in bytes
 unsigned char * hash_occupied {nullptr};
 uint64_t * hash_values {nullptr};
 unsigned int * hash_data {nullptr};
@@ -122,33 +127,86 @@ auto hash_set_data(const uint64_t index, const unsigned int amplicon_id) -> void
 }
 
 
+inline auto check_amp_identical(unsigned int const amp1,
+                                unsigned int const amp2) -> bool
+{
+  /* amplicon are identical if they have the same length, and the
+     exact same sequence */
+  const auto amp1_seqlen = db_getsequencelen(amp1);
+  const auto amp2_seqlen = db_getsequencelen(amp2);
+
+  return ((amp1_seqlen == amp2_seqlen) and
+          std::equal(db_getsequence(amp1),
+                     std::next(db_getsequence(amp1), nt_bytelength(amp1_seqlen)),
+                     db_getsequence(amp2)));
+}
+
+
+auto hash_insert(unsigned int const amp) -> bool
+{
+  /* store amp in the first empty bucket; true if an identical
+     amplicon was already stored */
+  const auto hash = db_gethash(amp);
+  auto index = hash_getindex(hash);
+  auto duplicate = false;
+  while (hash_is_occupied(index))
+    {
+      if (hash_compare_value(index, hash) and
+          check_amp_identical(amp, hash_get_data(index))) {
+        duplicate = true;
+      }
+      index = hash_getnextindex(index);
+    }
+
+  hash_set_occupied(index);
+  hash_set_value(index, hash);
+  hash_set_data(index, amp);
+
+  return duplicate;
+}
+
+
 auto hash_alloc(const uint64_t amplicons,
-                std::vector<unsigned char>& hash_occupied_v,
-                std::vector<uint64_t>& hash_values_v,
-                std::vector<unsigned int>& hash_data_v) -> uint64_t
+                std::unique_ptr<unsigned char[]>& hash_occupied_p,
+                std::unique_ptr<uint64_t[]>& hash_values_p,
+                std::unique_ptr<unsigned int[]>& hash_data_p) -> uint64_t
 {
+  /* tables are allocated uninitialized, and first touched by all
+     threads (see utils/first_touch.h) */
   static constexpr int padding {63};  // make sure our final value is >= 64 / 8
   static constexpr int convert_to_bytes {8};
 
   const auto hashtablesize = compute_hashtable_size(amplicons);
   hash_mask = hashtablesize - 1;
 
-  hash_occupied_v.resize((hashtablesize + padding) / convert_to_bytes);
-  hash_occupied = hash_occupied_v.data();
+  hash_occupied_size = (hashtablesize + padding) / convert_to_bytes;
+  hash_occupied_p.reset(new unsigned char[hash_occupied_size]);
+  hash_occupied = hash_occupied_p.get();
+  first_touch_fill(hash_occupied, hash_occupied_size, 0);
 
-  hash_values_v.resize(hashtablesize);
-  hash_values = hash_values_v.data();
+  hash_values_p.reset(new uint64_t[hashtablesize]);
+  hash_values = hash_values_p.get();
+  first_touch_fill(hash_values, hashtablesize * sizeof(uint64_t), 0);
 
-  hash_data_v.resize(hashtablesize);
-  hash_data = hash_data_v.data();
+  hash_data_p.reset(new unsigned int[hashtablesize]);
+  hash_data = hash_data_p.get();
+  first_touch_fill(hash_data, hashtablesize * sizeof(unsigned int), 0);
 
   return hashtablesize;
 }
 
 
+auto hash_zap() -> void
+{
+  /* mark all buckets as empty */
+  parallel_fill(hash_occupied, hash_occupied_size, 0);
+}
+
+
 auto hash_free() -> void
 {
   hash_occupied = nullptr;
+  hash_occupied_size = 0;
   hash_values = nullptr;
   hash_data = nullptr;
 }
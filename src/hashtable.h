@@ -22,7 +22,7 @@
 */
 
 #include <cstdint>
-#include <vector>
+#include <memory>  // std::unique_ptr
 
 
 auto hash_getindex(uint64_t hash) -> uint64_t;
@@ -41,9 +41,13 @@ auto hash_get_data(uint64_t index) -> unsigned int;
 
 auto hash_set_data(uint64_t index, unsigned int amplicon_id) -> void;
 
+auto hash_insert(unsigned int amp) -> bool;
+
 auto hash_alloc(uint64_t amplicons,
-                std::vector<unsigned char>& hash_occupied_v,
-                std::vector<uint64_t>& hash_values_v,
-                std::vector<unsigned int>& hash_data_v) -> uint64_t;
+                std::unique_ptr<unsigned char[]>& hash_occupied_p,
+                std::unique_ptr<uint64_t[]>& hash_values_p,
+                std::unique_ptr<unsigned int[]>& hash_data_p) -> uint64_t;
+
+auto hash_zap() -> void;
 
 auto hash_free() -> void;
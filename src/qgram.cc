@@ -47,22 +47,16 @@
 #endif
 
 #include "utils/qgram_array.h"
-#include "utils/qgram_threadinfo.h"
 #include "utils/nt_codec.h"
-#include "utils/opt_threads.h"
-#include "utils/threads.h"
 #include <cassert>
 #include <cstddef>  // std::ptrdiff_t
 #include <cstdint>  // int64_t, uint64_t
 #include <cstring>  // memset
 #include <iterator>  // std::next
 #include <limits>
-#include <vector>
 
 
 qgramvector_t * qgrams {nullptr};
-static ThreadRunner * qgram_threads = nullptr;
-static struct thread_info_s * thread_info_ptr;
 
 
 auto findqgrams(unsigned char * seq, uint64_t seqlen,
@@ -95,8 +89,6 @@ auto findqgrams(unsigned char * seq, uint64_t seqlen,
   }
 }
 
-auto qgram_work_diff(thread_info_s * tip) -> void;
-auto qgram_worker(int64_t nth_thread) -> void;
 auto compareqgramvectors(unsigned char * lhs, unsigned char * rhs) -> uint64_t;
 
 #ifdef __aarch64__
@@ -252,16 +244,14 @@ inline auto qgram_diff(uint64_t seqno_a, uint64_t seqno_b) -> uint64_t
 }
 
 
-auto qgram_worker(int64_t const nth_thread) -> void
+auto qgram_diff_list(uint64_t const seed,
+                     uint64_t const listlen,
+                     uint64_t const * amplist,
+                     uint64_t * difflist) -> void
 {
-  auto const & tip = *std::next(thread_info_ptr, nth_thread);
-
-  const auto seed = tip.seed;
-  const auto listlen = tip.listlen;
+  /* in the calling thread */
   assert(listlen <= std::numeric_limits<std::ptrdiff_t>::max());
   const auto listlen_signed = static_cast<int64_t>(listlen);
-  auto * amplist = tip.amplist;
-  auto * difflist = tip.difflist;
 
   for(auto i = 0LL; i < listlen_signed; ++i) {
     auto & target_diff = *std::next(difflist, i);
@@ -270,66 +260,3 @@ auto qgram_worker(int64_t const nth_thread) -> void
   }
 }
 
-
-auto qgram_diff_init(std::vector<struct thread_info_s>& thread_info_v) -> void
-{
-  /* allocate memory for thread info */
-  thread_info_v.resize(static_cast<uint64_t>(opt_threads));
-  thread_info_ptr = thread_info_v.data();
-  assert(opt_threads <= std::numeric_limits<int>::max());
-  qgram_threads
-    = new ThreadRunner(static_cast<int>(opt_threads), qgram_worker);
-}
-
-
-auto qgram_diff_done() -> void
-{
-  delete qgram_threads;
-  qgram_threads = nullptr;
-  thread_info_ptr = nullptr;
-}
-
-
-auto qgram_diff_fast(uint64_t seed,
-                     uint64_t listlen,
-                     uint64_t * amplist,
-                     uint64_t * difflist,
-                     std::vector<struct thread_info_s>& thread_info_v) -> void
-{
-  static constexpr auto uint8_max = std::numeric_limits<uint8_t>::max();
-  if (listlen <= uint8_max)
-    {
-      auto & tip = thread_info_v[0];
-      tip.seed = seed;
-      tip.listlen = listlen;
-      tip.amplist = amplist;
-      tip.difflist = difflist;
-      qgram_worker(0);
-    }
-  else
-    {
-      auto * next_amplist = amplist;
-      auto * next_difflist = difflist;
-      auto listrest = listlen;
-      auto thrrest = static_cast<uint64_t>(opt_threads);
-
-      /* distribute work */
-      for(auto & tip: thread_info_v) {
-          auto const chunk = (listrest + thrrest - 1) / thrrest;
-          assert(chunk <= std::numeric_limits<std::ptrdiff_t>::max());
-          auto const chunk_signed = static_cast<int64_t>(chunk);
-
-          tip.seed = seed;
-          tip.listlen = chunk;
-          tip.amplist = next_amplist;
-          tip.difflist = next_difflist;
-
-          next_amplist = std::next(next_amplist, chunk_signed);
-          next_difflist = std::next(next_difflist, chunk_signed);
-          listrest -= chunk;
-          --thrrest;
-        }
-
-      qgram_threads->run();
-    }
-}
@@ -26,38 +26,13 @@
 #include "search16.h"
 #include "utils/alignment_parameters.h"
 #include "utils/nt_codec.h"
-#include "utils/opt_threads.h"
-#include "utils/queryinfo.h"
 #include "utils/search_data.h"
 #include "utils/score_matrix.h"
-#include "utils/threads.h"
+#include <algorithm>  // std::max
 #include <cassert>  // assert()
-#include <cstddef>  // std::ptrdiff_t
 #include <cstdint>  // int64_t, uint64_t
-#include <iterator>
-#include <pthread.h>  // pthread_mutex_init
-#include <vector>
-
-#ifndef NDEBUG
-// C++17 refactoring: [[maybe_unused]]
 #include <limits>
-constexpr auto ullong_max = std::numeric_limits<unsigned long long int>::max();
-#endif
-
-
-static pthread_mutex_t scan_mutex;
-
-static struct Search_data * search_data;
-static uint64_t master_next;
-static uint64_t master_length;
-static uint64_t remainingchunks;
-static uint64_t * master_targets;
-static uint64_t * master_scores;
-static uint64_t * master_diffs;
-static uint64_t * master_alignlengths;
-static int master_bits;
-
-struct queryinfo query;
+#include <vector>
 
 
 auto allocate_per_thread_search_data(std::vector<struct Search_data>& search_data_v,
@@ -65,6 +40,7 @@ auto allocate_per_thread_search_data(std::vector<struct Search_data>& search_dat
 {
   static constexpr auto one_kilobyte = 1024UL;
   static constexpr auto nt_per_uint64 = 32U;
+  static constexpr auto bytes_per_row = 16U;  // one vector per query row
   const uint64_t dirbuffersize = longestdbsequence * ((longestdbsequence + 3) / 4) * 4;
 
   for(auto& thread_data: search_data_v) {
@@ -74,18 +50,23 @@ auto allocate_per_thread_search_data(std::vector<struct Search_data>& search_dat
     thread_data.dprofile_w_v.resize(1 * one_kilobyte);  // 4 * 2 * 8 * 32
     thread_data.hearray_v.resize(longestdbsequence * nt_per_uint64);
     thread_data.dir_array_v.resize(dirbuffersize);
+    thread_data.qsymbols_v.resize(longestdbsequence * bytes_per_row);
+    thread_data.qlast_v.resize(longestdbsequence * bytes_per_row);
+    thread_data.lastrows_v.resize(longestdbsequence);
   }
 }
 
 
-auto search_init(struct Search_data & thread_data) -> void
+auto search_init(struct Search_data & thread_data,
+                 char * query_seq,
+                 unsigned int const query_len) -> void
 {
   static constexpr auto byte_multiplier = 64U;
   static constexpr auto word_multiplier = 32U;
 
-  for(auto i = 0U; i < query.len; ++i)
+  for(auto i = 0U; i < query_len; ++i)
   {
-    const auto nt_value = nt_extract(query.seq, i) + 1U;  // 1,  2,   3, or   4
+    const auto nt_value = nt_extract(query_seq, i) + 1U;  // 1,  2,   3, or   4
     const auto byte_offset = byte_multiplier * nt_value;  // 1, 64, 128, or 192
     const auto word_offset = word_multiplier * nt_value;  // 1, 32,  64, or 128
 
@@ -96,14 +77,19 @@ auto search_init(struct Search_data & thread_data) -> void
 }
 
 
-auto search_chunk(struct Search_data & thread_data, const int64_t bits) -> void
+auto search_chunk(struct Search_data & thread_data,
+                  const int64_t bits,
+                  char * query_seq,
+                  unsigned int const query_len,
+                  uint64_t * targets,
+                  uint64_t * scores,
+                  uint64_t * diffs,
+                  uint64_t * alignlengths) -> void
 {
   static constexpr auto sixteen_bytes = 16;
   alignas(sixteen_bytes) static auto score_matrix_8 = create_score_matrix<unsigned char>(penalty_mismatch);
   alignas(sixteen_bytes) static auto score_matrix_16 = create_score_matrix<unsigned short>(penalty_mismatch);
   static constexpr auto bit_mode_16 = 16U;
-  assert(thread_data.target_index <= std::numeric_limits<std::ptrdiff_t>::max());
-  auto const target_index = static_cast<std::ptrdiff_t>(thread_data.target_index);
 
   assert(thread_data.target_count != 0);
   assert((bits == bit_mode_16) or (bits == bit_mode_16 / 2));
@@ -118,11 +104,12 @@ auto search_chunk(struct Search_data & thread_data, const int64_t bits) -> void
              thread_data.dprofile_w_v,
              reinterpret_cast<WORD *>(thread_data.hearray_v.data()),
              thread_data.target_count,
-             std::next(master_targets, target_index),
-             std::next(master_scores, target_index),
-             std::next(master_diffs, target_index),
-             std::next(master_alignlengths, target_index),
-             static_cast<uint64_t>(query.len),
+             targets,
+             scores,
+             diffs,
+             alignlengths,
+             query_seq,
+             static_cast<uint64_t>(query_len),
              thread_data.dir_array_v);
   } else {
     assert(penalty_gapopen <= std::numeric_limits<BYTE>::max());
@@ -134,141 +121,104 @@ auto search_chunk(struct Search_data & thread_data, const int64_t bits) -> void
             thread_data.dprofile_v,
             thread_data.hearray_v.data(),
             thread_data.target_count,
-            std::next(master_targets, target_index),
-            std::next(master_scores, target_index),
-            std::next(master_diffs, target_index),
-            std::next(master_alignlengths, target_index),
-            static_cast<uint64_t>(query.len),
+            targets,
+            scores,
+            diffs,
+            alignlengths,
+            query_seq,
+            static_cast<uint64_t>(query_len),
             thread_data.dir_array_v);
   }
 }
 
 
-auto search_getwork(uint64_t & countref, uint64_t & firstref) -> bool
+auto search_list(struct Search_data & thread_data,
+                 const uint64_t query_no,
+                 const uint64_t listlength,
+                 uint64_t * targets,
+                 uint64_t * scores,
+                 uint64_t * diffs,
+                 uint64_t * alignlengths,
+                 const int bits) -> void
 {
-  // countref = how many sequences to search
-  // firstref = index into master_targets/scores/diffs where thread should start
-
-  bool status {false};
-
-  pthread_mutex_lock(&scan_mutex);
-
-  if (master_next < master_length)
-    {
-      const uint64_t chunksize =
-        ((master_length - master_next + remainingchunks - 1) / remainingchunks);
-
-      countref = chunksize;
-      firstref = master_next;
-
-      master_next += chunksize;
-      --remainingchunks;
-      status = true;
-    }
-
-  pthread_mutex_unlock(&scan_mutex);
-
-  return status;
-}
-
-
-auto search_worker_core(const int64_t thread_id) -> void {
-  auto & thread_data = *std::next(search_data, thread_id);
-  search_init(thread_data);
-  while(search_getwork(thread_data.target_count, thread_data.target_index)) {
-    search_chunk(thread_data, master_bits);
-  }
-}
-
-
-auto adjust_thread_number(const int n_bits,
-                          const uint64_t remaining_sequences,
-                          uint64_t n_threads) -> uint64_t {
-  static constexpr auto channels_8 = 8U;
-  static constexpr auto channels_16 = 16U;
-  static constexpr auto bit_mode_16 = 16U;  // refactoring: should be an enum class
-  const auto channels = (n_bits == bit_mode_16) ? channels_8 : channels_16;
-
-  assert(remaining_sequences != 0);
-  assert(n_threads != 0);
-  assert((n_threads - 1) <= (ullong_max / channels_8));
-  assert((n_bits == bit_mode_16) or (n_bits == bit_mode_16 / 2));
-
-  while (remaining_sequences <= (n_threads - 1) * channels) {
-    --n_threads;
-  }
-
-  return n_threads;
+  /* align query to all targets in the calling thread, with its own
+     search data (threads can search different queries at once) */
+  char * query_seq {nullptr};
+  auto query_len = 0U;
+  db_getsequenceandlength(query_no, query_seq, query_len);
+  search_init(thread_data, query_seq, query_len);
+  thread_data.target_count = listlength;
+  thread_data.target_index = 0;
+  search_chunk(thread_data, bits, query_seq, query_len, targets, scores, diffs, alignlengths);
 }
 
-// arguments: bits, master_length, thr
-// static_assert(adjust_thread_number( 8, 32, 10) == 2);
-// static_assert(adjust_thread_number( 8, 32,  3) == 2);
-// static_assert(adjust_thread_number( 8, 31,  2) == 2);
-// static_assert(adjust_thread_number( 8, 17,  2) == 2);
-// static_assert(adjust_thread_number( 8, 16,  2) == 1);
-// static_assert(adjust_thread_number( 8,  1,  2) == 1);
-// static_assert(adjust_thread_number( 8, 32,  1) == 1);
-// static_assert(adjust_thread_number(16, 17, 10) == 3);
-// static_assert(adjust_thread_number(16, 17,  3) == 3);
-// static_assert(adjust_thread_number(16, 16,  3) == 2);
-// static_assert(adjust_thread_number(16, 15,  2) == 2);
-// static_assert(adjust_thread_number(16,  1,  3) == 1);
-// static_assert(adjust_thread_number(16, 17,  1) == 1);
 
-
-auto search_do(const uint64_t query_no,
-               const uint64_t listlength,
-               uint64_t * targets,
-               uint64_t * scores,
-               uint64_t * diffs,
-               uint64_t * alignlengths,
-               const int bits,
-               ThreadRunner * search_threads) -> void
+auto search_pairs(struct Search_data & thread_data,
+                  const uint64_t pair_count,
+                  uint64_t * queries,
+                  uint64_t * targets,
+                  uint64_t * scores,
+                  uint64_t * diffs,
+                  uint64_t * alignlengths,
+                  const int bits) -> void
 {
-  auto query_len = 0U;
-  query.qno = query_no;
-  db_getsequenceandlength(query_no, query.seq, query_len);
-  query.len = query_len;
-
-  master_next = 0;
-  master_length = listlength;
-  master_targets = targets;
-  master_scores = scores;
-  master_diffs = diffs;
-  master_alignlengths = alignlengths;
-  master_bits = bits;
-
-  const auto thr =
-    adjust_thread_number(bits,
-                         master_length,
-                         static_cast<uint64_t>(opt_threads));
+  /* align each query to its own target in the calling thread,
+     several pairs at once (a query per channel) */
+  static constexpr auto bit_mode_16 = 16U;
 
-  remainingchunks = thr;
+  assert(pair_count != 0);
+  assert((bits == bit_mode_16) or (bits == bit_mode_16 / 2));
 
-  if (thr == 1) {
-    search_worker_core(0);
+  uint64_t rows {0};
+  for(auto i = 0ULL; i < pair_count; ++i) {
+    rows = std::max<uint64_t>(rows, db_getsequencelen(queries[i]));
   }
-  else {
-    search_threads->run();
+
+  if (bits == bit_mode_16) {
+    assert(penalty_gapopen <= std::numeric_limits<WORD>::max());
+    assert(penalty_gapextend <= std::numeric_limits<WORD>::max());
+    assert(penalty_mismatch <= std::numeric_limits<WORD>::max());
+    search16_pairs(static_cast<WORD>(penalty_gapopen),
+                   static_cast<WORD>(penalty_gapextend),
+                   static_cast<WORD>(penalty_mismatch),
+                   reinterpret_cast<WORD *>(thread_data.qsymbols_v.data()),
+                   reinterpret_cast<WORD *>(thread_data.qlast_v.data()),
+                   thread_data.lastrows_v.data(),
+                   reinterpret_cast<WORD *>(thread_data.hearray_v.data()),
+                   rows,
+                   pair_count,
+                   queries,
+                   targets,
+                   scores,
+                   diffs,
+                   alignlengths,
+                   db_getlongestsequence(),
+                   thread_data.dir_array_v);
+  } else {
+    assert(penalty_gapopen <= std::numeric_limits<BYTE>::max());
+    assert(penalty_gapextend <= std::numeric_limits<BYTE>::max());
+    assert(penalty_mismatch <= std::numeric_limits<BYTE>::max());
+    search8_pairs(static_cast<BYTE>(penalty_gapopen),
+                  static_cast<BYTE>(penalty_gapextend),
+                  static_cast<BYTE>(penalty_mismatch),
+                  thread_data.qsymbols_v.data(),
+                  thread_data.qlast_v.data(),
+                  thread_data.lastrows_v.data(),
+                  thread_data.hearray_v.data(),
+                  rows,
+                  pair_count,
+                  queries,
+                  targets,
+                  scores,
+                  diffs,
+                  alignlengths,
+                  db_getlongestsequence(),
+                  thread_data.dir_array_v);
   }
 }
 
 
 auto search_begin(std::vector<struct Search_data> & search_data_v) -> void
 {
-  search_data = search_data_v.data();
-
   allocate_per_thread_search_data(search_data_v, db_getlongestsequence());
-
-  pthread_mutex_init(&scan_mutex, nullptr);
-}
-
-
-auto search_end() -> void
-{
-  /* finish and clean up worker threads */
-
-  pthread_mutex_destroy(&scan_mutex);
-  search_data = nullptr;
 }
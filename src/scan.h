@@ -21,20 +21,25 @@
     PO Box 1080 Blindern, NO-0316 Oslo, Norway
 */
 
-#include "utils/threads.h"
 #include <cstdint>  // int64_t
 #include <vector>
 
 
 auto search_all(uint64_t query_no) -> void;
-auto search_do(uint64_t query_no,
-               uint64_t listlength,
-               uint64_t * targets,
-               uint64_t * scores,
-               uint64_t * diffs,
-               uint64_t * alignlengths,
-               int bits,
-               ThreadRunner * search_threads) -> void;
+auto search_list(struct Search_data & thread_data,
+                 uint64_t query_no,
+                 uint64_t listlength,
+                 uint64_t * targets,
+                 uint64_t * scores,
+                 uint64_t * diffs,
+                 uint64_t * alignlengths,
+                 int bits) -> void;
+auto search_pairs(struct Search_data & thread_data,
+                  uint64_t pair_count,
+                  uint64_t * queries,
+                  uint64_t * targets,
+                  uint64_t * scores,
+                  uint64_t * diffs,
+                  uint64_t * alignlengths,
+                  int bits) -> void;
 auto search_begin(std::vector<struct Search_data>& search_data_v) -> void;
-auto search_end() -> void;
-auto search_worker_core(int64_t thread_id) -> void;
@@ -23,7 +23,7 @@
 
 #include "db.h"
 #include "utils/backtrack.h"
-#include "utils/queryinfo.h"
+#include <algorithm>  // std::fill
 #include <array>
 #include <cassert>
 #include <cstddef>  // std::ptrdiff_t
@@ -393,6 +393,7 @@ auto search16(std::vector<WORD *> & q_start,
               uint64_t * scores,
               uint64_t * diffs,
               uint64_t * alignmentlengths,
+              char * qseq,
               uint64_t qlen,
               std::vector<uint64_t> & dirbuffer) -> void
 {
@@ -556,7 +557,7 @@ auto search16(std::vector<WORD *> & q_start,
                       if (score < uint16_max)
                         {
                           const uint64_t offset = d_offset[channel];
-                          diff = backtrack<n_bits>(query.seq, dbseq, qlen, dbseqlen,
+                          diff = backtrack<n_bits>(qseq, dbseq, qlen, dbseqlen,
                                                    dirbuffer,
                                                    offset,
                                                    channel,
@@ -676,3 +677,478 @@ auto search16(std::vector<WORD *> & q_start,
       }
     }
 }
+
+inline auto pairs_scores_16(VECTORTYPE const & q,
+                            VECTORTYPE const * D,
+                            VECTORTYPE const & mismatch,
+                            VECTORTYPE * x) -> void
+{
+  // 0 if symbols are identical, mismatch penalty otherwise
+  *std::next(x, 0) = v_sub16(mismatch, v_eq16(q, *std::next(D, 0)));
+  *std::next(x, 1) = v_sub16(mismatch, v_eq16(q, *std::next(D, 1)));
+  *std::next(x, 2) = v_sub16(mismatch, v_eq16(q, *std::next(D, 2)));
+  *std::next(x, 3) = v_sub16(mismatch, v_eq16(q, *std::next(D, 3)));
+}
+
+
+auto align_cells_pairs_regular_16(VECTORTYPE * Sm,
+                                  VECTORTYPE * hep,
+                                  VECTORTYPE const * qs,
+                                  VECTORTYPE const * ql,
+                                  BYTE const * lastrows,
+                                  VECTORTYPE const * D,
+                                  VECTORTYPE * MISm,
+                                  VECTORTYPE * Qm,
+                                  VECTORTYPE * Rm,
+                                  uint64_t rows,
+                                  VECTORTYPE * F0,
+                                  uint64_t * dir_long,
+                                  VECTORTYPE * H0) -> void
+{
+  static constexpr auto step = 16;
+  static constexpr auto offset0 = 0;
+  static constexpr auto offset1 = offset0 + 4;
+  static constexpr auto offset2 = offset1 + 4;
+  static constexpr auto offset3 = offset2 + 4;
+
+  VECTORTYPE E;
+  VECTORTYPE h4;
+  VECTORTYPE x[cdepth];
+
+  auto * dir = reinterpret_cast<WORD *>(dir_long);
+
+  const auto Q = *Qm;
+  const auto R = *Rm;
+  const auto mismatch = *MISm;
+
+  auto f0 = *F0;
+  auto f1 = v_add16(f0, R);
+  auto f2 = v_add16(f1, R);
+  auto f3 = v_add16(f2, R);
+
+  auto h0 = *H0;
+  auto h1 = v_sub16(f0, Q);
+  auto h2 = v_add16(h1, R);
+  auto h3 = v_add16(h2, R);
+
+  auto h5 = v_zero16();
+  auto h6 = v_zero16();
+  auto h7 = v_zero16();
+  auto h8 = v_zero16();
+
+  auto s0 = *std::next(Sm, 0);
+  auto s1 = *std::next(Sm, 1);
+  auto s2 = *std::next(Sm, 2);
+  auto s3 = *std::next(Sm, 3);
+
+  assert(rows <= max_ptrdiff);
+  assert(rows <= ((max_ptrdiff - 1) / 2));  // max 'E' offset
+  assert(rows <= ((max_ptrdiff - offset3) / step));  // max 'dir' offset
+  auto const rows_signed = static_cast<std::ptrdiff_t>(rows);
+  for(auto pos = 0LL; pos < rows_signed; ++pos)
+    {
+      pairs_scores_16(*std::next(qs, pos), D, mismatch, x);
+      h4 = *std::next(hep, 2 * pos + 0);
+      E  = *std::next(hep, 2 * pos + 1);
+      onestep_16(h0, h5, f0, x[0], std::next(dir, step * pos + offset0), E, Q, R);
+      onestep_16(h1, h6, f1, x[1], std::next(dir, step * pos + offset1), E, Q, R);
+      onestep_16(h2, h7, f2, x[2], std::next(dir, step * pos + offset2), E, Q, R);
+      onestep_16(h3, h8, f3, x[3], std::next(dir, step * pos + offset3), E, Q, R);
+      *std::next(hep, 2 * pos + 0) = h8;
+      *std::next(hep, 2 * pos + 1) = E;
+
+      if (*std::next(lastrows, pos) != 0)
+        {
+          /* last row of the query of one or more channels (0 in
+             these channels, 65535 in the others) */
+          const auto last = *std::next(ql, pos);
+          s0 = v_min16(s0, v_add16(h5, last));
+          s1 = v_min16(s1, v_add16(h6, last));
+          s2 = v_min16(s2, v_add16(h7, last));
+          s3 = v_min16(s3, v_add16(h8, last));
+        }
+
+      h0 = h4;
+      h1 = h5;
+      h2 = h6;
+      h3 = h7;
+    }
+
+  *std::next(Sm, 0) = s0;
+  *std::next(Sm, 1) = s1;
+  *std::next(Sm, 2) = s2;
+  *std::next(Sm, 3) = s3;
+}
+
+
+auto align_cells_pairs_masked_16(VECTORTYPE * Sm,
+                                 VECTORTYPE * hep,
+                                 VECTORTYPE const * qs,
+                                 VECTORTYPE const * ql,
+                                 BYTE const * lastrows,
+                                 VECTORTYPE const * D,
+                                 VECTORTYPE * MISm,
+                                 VECTORTYPE * Qm,
+                                 VECTORTYPE * Rm,
+                                 uint64_t rows,
+                                 VECTORTYPE * F0,
+                                 uint64_t * dir_long,
+                                 VECTORTYPE * H0,
+                                 VECTORTYPE * Mm,
+                                 VECTORTYPE * MQ,
+                                 VECTORTYPE * MR,
+                                 VECTORTYPE * MQ0) -> void
+{
+  static constexpr auto step = 16;
+  static constexpr auto offset0 = 0;
+  static constexpr auto offset1 = offset0 + 4;
+  static constexpr auto offset2 = offset1 + 4;
+  static constexpr auto offset3 = offset2 + 4;
+
+  VECTORTYPE E;
+  VECTORTYPE h4;
+  VECTORTYPE x[cdepth];
+
+  auto * dir = reinterpret_cast<WORD *>(dir_long);
+
+  const auto Q = *Qm;
+  const auto R = *Rm;
+  const auto mismatch = *MISm;
+
+  auto f0 = *F0;
+  auto f1 = v_add16(f0, R);
+  auto f2 = v_add16(f1, R);
+  auto f3 = v_add16(f2, R);
+
+  auto h0 = *H0;
+  auto h1 = v_sub16(f0, Q);
+  auto h2 = v_add16(h1, R);
+  auto h3 = v_add16(h2, R);
+
+  auto h5 = v_zero16();
+  auto h6 = v_zero16();
+  auto h7 = v_zero16();
+  auto h8 = v_zero16();
+
+  auto s0 = *std::next(Sm, 0);
+  auto s1 = *std::next(Sm, 1);
+  auto s2 = *std::next(Sm, 2);
+  auto s3 = *std::next(Sm, 3);
+
+  assert(rows <= max_ptrdiff);
+  assert(rows <= ((max_ptrdiff - 1) / 2));  // max 'E' offset
+  assert(rows <= ((max_ptrdiff - offset3) / step));  // max 'dir' offset
+  auto const rows_signed = static_cast<std::ptrdiff_t>(rows);
+  for(auto pos = 0LL; pos < rows_signed; ++pos)
+    {
+      pairs_scores_16(*std::next(qs, pos), D, mismatch, x);
+      h4 = *std::next(hep, 2 * pos + 0);
+      E  = *std::next(hep, 2 * pos + 1);
+
+      /* mask h4 and E */
+      h4 = v_sub16(h4, *Mm);
+      E  = v_sub16(E,  *Mm);
+
+      /* init h4 and E */
+      h4 = v_add16(h4, *MQ);
+      E  = v_add16(E,  *MQ);
+      E  = v_add16(E,  *MQ0);
+
+      /* update MQ */
+      *MQ = v_add16(*MQ,  *MR);
+
+      onestep_16(h0, h5, f0, x[0], std::next(dir, step * pos + offset0), E, Q, R);
+      onestep_16(h1, h6, f1, x[1], std::next(dir, step * pos + offset1), E, Q, R);
+      onestep_16(h2, h7, f2, x[2], std::next(dir, step * pos + offset2), E, Q, R);
+      onestep_16(h3, h8, f3, x[3], std::next(dir, step * pos + offset3), E, Q, R);
+      *std::next(hep, 2 * pos + 0) = h8;
+      *std::next(hep, 2 * pos + 1) = E;
+
+      if (*std::next(lastrows, pos) != 0)
+        {
+          const auto last = *std::next(ql, pos);
+          s0 = v_min16(s0, v_add16(h5, last));
+          s1 = v_min16(s1, v_add16(h6, last));
+          s2 = v_min16(s2, v_add16(h7, last));
+          s3 = v_min16(s3, v_add16(h8, last));
+        }
+
+      h0 = h4;
+      h1 = h5;
+      h2 = h6;
+      h3 = h7;
+    }
+
+  *std::next(Sm, 0) = s0;
+  *std::next(Sm, 1) = s1;
+  *std::next(Sm, 2) = s2;
+  *std::next(Sm, 3) = s3;
+}
+
+
+auto search16_pairs(WORD gap_open_penalty,
+                    WORD gap_extend_penalty,
+                    WORD mismatch_penalty,
+                    WORD * qsymbols,
+                    WORD * qlast,
+                    BYTE * lastrows,
+                    WORD * hearray,
+                    uint64_t rows,
+                    uint64_t pairs,
+                    uint64_t * queries,
+                    uint64_t * seqnos,
+                    uint64_t * scores,
+                    uint64_t * diffs,
+                    uint64_t * alignmentlengths,
+                    uint64_t longestdbsequence,
+                    std::vector<uint64_t> & dirbuffer) -> void
+{
+  static constexpr auto uint16_max = std::numeric_limits<uint16_t>::max();
+  VECTORTYPE T;
+  VECTORTYPE M;
+  VECTORTYPE MQ;
+  VECTORTYPE MR;
+  VECTORTYPE MQ0;
+
+  std::array<uint64_t, channels> d_pos {{}};
+  std::array<uint64_t, channels> d_offset {{}};
+  std::array<char *, channels> d_address {{}};
+  std::array<uint64_t, channels> d_length {{}};
+  std::array<char *, channels> q_address {{}};
+  std::array<uint64_t, channels> q_length {{}};
+  std::array<int64_t, channels> seq_id {{}};
+  seq_id.fill(-1);
+
+  VECTORTYPE S[4];
+
+  // target symbols of the current block, interpreted as an array of
+  // WORDS (channels * j + channel)
+  VECTORTYPE D[cdepth];
+  auto * dseq = reinterpret_cast<WORD *>(D);
+
+  uint64_t next_id {0};
+  uint64_t done {0};
+
+#ifdef __aarch64__
+  const VECTORTYPE T0 = { uint16_max, 0, 0, 0, 0, 0, 0, 0 };
+#elif defined __x86_64__
+  const auto T0 = _mm_set_epi16(0, 0, 0, 0, 0, 0, 0, -1);
+#elif defined __PPC__
+  static constexpr auto unsigned_short_max = std::numeric_limits<unsigned short>::max();
+  const VECTORTYPE T0 = { unsigned_short_max, 0, 0, 0, 0, 0, 0, 0 };
+#endif
+
+  assert(gap_open_penalty + gap_extend_penalty <= std::numeric_limits<short>::max());
+  assert(gap_extend_penalty <= std::numeric_limits<short>::max());
+  auto Q = v_dup16(static_cast<short>(gap_open_penalty + gap_extend_penalty));
+  auto R = v_dup16(static_cast<short>(gap_extend_penalty));
+  auto MIS = v_dup16(static_cast<short>(mismatch_penalty));
+  const auto S0 = v_dup16(static_cast<short>(uint16_max));
+
+  // no query yet: no symbol, no last row
+  assert(rows * channels <= max_ptrdiff);
+  std::fill(qsymbols, std::next(qsymbols, static_cast<std::ptrdiff_t>(rows * channels)), 0);
+  std::fill(qlast, std::next(qlast, static_cast<std::ptrdiff_t>(rows * channels)), uint16_max);
+  std::fill(lastrows, std::next(lastrows, static_cast<std::ptrdiff_t>(rows)), 0);
+
+  auto *hep = reinterpret_cast<VECTORTYPE*>(hearray);
+  auto const *qs = reinterpret_cast<VECTORTYPE const *>(qsymbols);
+  auto const *ql = reinterpret_cast<VECTORTYPE const *>(qlast);
+
+  auto F0 = v_zero16();
+  auto H0 = v_zero16();
+
+  bool easy {false};
+
+  uint64_t * dir = dirbuffer.data();
+
+  auto fill_channel = [&](unsigned int const channel) -> void {
+    for(auto j = 0U; j < cdepth; ++j)
+      {
+        if (d_pos[channel] < d_length[channel]) {
+          *std::next(dseq, channels * j + channel)
+            = 1 + nt_extract(d_address[channel], d_pos[channel]);
+          ++d_pos[channel];
+        }
+        else {
+          *std::next(dseq, channels * j + channel) = 0;
+        }
+      }
+    if (d_pos[channel] == d_length[channel]) {
+      easy = false;
+    }
+  };
+
+  auto clear_last_row = [&](unsigned int const channel) -> void {
+    if (q_length[channel] == 0) {
+      return;
+    }
+    const auto last = q_length[channel] - 1;
+    *std::next(qlast, static_cast<std::ptrdiff_t>(last * channels + channel)) = uint16_max;
+    --*std::next(lastrows, static_cast<std::ptrdiff_t>(last));
+  };
+
+  while(true)
+    {
+      if (easy)
+        {
+          // fill all channels
+
+          for(auto channel = 0U; channel < channels; ++channel) {
+            fill_channel(channel);
+          }
+
+          // S: scores of the last row of the queries ending in the block
+          for(auto & s: S) {
+            s = S0;
+          }
+          align_cells_pairs_regular_16(S, hep, qs, ql, lastrows, D, &MIS, &Q, &R,
+                                       rows, &F0, dir, &H0);
+        }
+      else
+        {
+          // One or more sequences ended in the previous block
+          // We have to switch over to a new pair
+
+          easy = true;
+
+          M = v_zero16();
+          T = T0;
+          for(auto channel = 0U; channel < channels; ++channel)
+            {
+              if (d_pos[channel] < d_length[channel])
+                {
+                  // this channel has more sequence
+                  fill_channel(channel);
+                }
+              else
+                {
+                  // sequence in channel ended,
+                  // change of pair
+
+                  M = v_xor16(M, T);
+
+                  const int64_t cand_id = seq_id[channel];
+
+                  if (cand_id >= 0)
+                    {
+                      // save score
+
+                      char * dbseq = d_address[channel];
+                      const uint64_t dbseqlen = d_length[channel];
+                      const uint64_t z = (dbseqlen + 3) % 4;
+                      assert(z * channels + channel <= max_ptrdiff);
+                      const uint64_t score
+                        = *std::next(reinterpret_cast<WORD *>(S), static_cast<std::ptrdiff_t>(z * channels + channel));
+                      *std::next(scores, cand_id) = score;
+
+                      uint64_t diff {0};
+
+                      if (score < uint16_max)
+                        {
+                          const uint64_t offset = d_offset[channel];
+                          diff = backtrack<n_bits>(q_address[channel], dbseq,
+                                                   q_length[channel], dbseqlen,
+                                                   dirbuffer,
+                                                   offset,
+                                                   channel,
+                                                   std::next(alignmentlengths, cand_id),
+                                                   longestdbsequence);
+                        }
+                      else
+                        {
+                          diff = uint16_max;
+                        }
+
+                      *std::next(diffs, cand_id) = diff;
+
+                      ++done;
+                    }
+
+                  clear_last_row(channel);
+
+                  if (next_id < pairs)
+                    {
+                      // get next pair
+                      assert(next_id <= std::numeric_limits<int64_t>::max());
+                      assert(next_id <= max_ptrdiff);
+                      seq_id[channel] = static_cast<int64_t>(next_id);
+                      char * address {nullptr};
+                      unsigned int length {0};
+
+                      db_getsequenceandlength(*std::next(queries, static_cast<std::ptrdiff_t>(next_id)),
+                                              address, length);
+                      assert(length != 0);
+                      assert(length <= rows);
+                      q_address[channel] = address;
+                      q_length[channel] = length;
+                      for(auto i = 0ULL; i < length; ++i) {
+                        *std::next(qsymbols, static_cast<std::ptrdiff_t>(i * channels + channel))
+                          = static_cast<WORD>(1 + nt_extract(address, i));
+                      }
+                      *std::next(qlast, static_cast<std::ptrdiff_t>((length - 1) * channels + channel)) = 0;
+                      ++*std::next(lastrows, static_cast<std::ptrdiff_t>(length - 1));
+
+                      db_getsequenceandlength(*std::next(seqnos, static_cast<std::ptrdiff_t>(next_id)),
+                                              address, length);
+
+                      d_address[channel] = address;
+                      d_length[channel] = length;
+
+                      d_pos[channel] = 0;
+                      d_offset[channel] = static_cast<uint64_t>(dir - dirbuffer.data());
+                      ++next_id;
+
+                      *std::next(reinterpret_cast<WORD *>(&H0), channel) = 0;
+                      assert(2U * gap_open_penalty + 2U * gap_extend_penalty <= std::numeric_limits<WORD>::max());
+                      *std::next(reinterpret_cast<WORD *>(&F0), channel) = static_cast<WORD>(2U * gap_open_penalty + 2U * gap_extend_penalty);
+
+                      fill_channel(channel);
+                    }
+                  else
+                    {
+                      // no more pairs, empty channel
+                      seq_id[channel] = -1;
+                      d_address[channel] = nullptr;
+                      d_pos[channel] = 0;
+                      d_length[channel] = 0;
+                      q_address[channel] = nullptr;
+                      q_length[channel] = 0;
+                      for(auto j = 0U; j < cdepth; ++j) {
+                        *std::next(dseq, channels * j + channel) = 0;
+                      }
+                    }
+                }
+
+              T = v_shift_left16(T);
+            }
+
+          if (done == pairs) {
+            break;
+          }
+
+          MQ = v_and16(M, Q);
+          MR = v_and16(M, R);
+          MQ0 = MQ;
+
+          for(auto & s: S) {
+            s = S0;
+          }
+          align_cells_pairs_masked_16(S, hep, qs, ql, lastrows, D, &MIS, &Q, &R,
+                                      rows, &F0, dir, &H0, &M, &MQ, &MR, &MQ0);
+        }
+
+      F0 = v_add16(F0, R);
+      F0 = v_add16(F0, R);
+      F0 = v_add16(F0, R);
+      H0 = v_sub16(F0, Q);
+      F0 = v_add16(F0, R);
+
+      assert(4 * longestdbsequence <= max_ptrdiff);
+      dir = std::next(dir, static_cast<std::ptrdiff_t>(4 * longestdbsequence));
+      assert(dirbuffer.size() <= max_ptrdiff);
+      if (dir >= std::next(dirbuffer.data(), static_cast<std::ptrdiff_t>(dirbuffer.size()))) {
+        dir = std::prev(dir, static_cast<std::ptrdiff_t>(dirbuffer.size()));
+      }
+    }
+}
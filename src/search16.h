@@ -25,6 +25,7 @@
 #include <vector>
 
 
+using BYTE = unsigned char;
 using WORD = unsigned short;
 
 auto search16(std::vector<WORD *> & q_start,
@@ -38,5 +39,23 @@ auto search16(std::vector<WORD *> & q_start,
               uint64_t * scores,
               uint64_t * diffs,
               uint64_t * alignmentlengths,
+              char * qseq,
               uint64_t qlen,
               std::vector<uint64_t> & dirbuffer) -> void;
+
+auto search16_pairs(WORD gap_open_penalty,
+                    WORD gap_extend_penalty,
+                    WORD mismatch_penalty,
+                    WORD * qsymbols,
+                    WORD * qlast,
+                    BYTE * lastrows,
+                    WORD * hearray,
+                    uint64_t rows,
+                    uint64_t pairs,
+                    uint64_t * queries,
+                    uint64_t * seqnos,
+                    uint64_t * scores,
+                    uint64_t * diffs,
+                    uint64_t * alignmentlengths,
+                    uint64_t longestdbsequence,
+                    std::vector<uint64_t> & dirbuffer) -> void;
@@ -38,5 +38,23 @@ auto search8(std::vector<BYTE *> & q_start,
              uint64_t * scores,
              uint64_t * diffs,
              uint64_t * alignmentlengths,
+             char * qseq,
              uint64_t qlen,
              std::vector<uint64_t> & dirbuffer) -> void;
+
+auto search8_pairs(BYTE gap_open_penalty,
+                   BYTE gap_extend_penalty,
+                   BYTE mismatch_penalty,
+                   BYTE * qsymbols,
+                   BYTE * qlast,
+                   BYTE * lastrows,
+                   BYTE * hearray,
+                   uint64_t rows,
+                   uint64_t pairs,
+                   uint64_t * queries,
+                   uint64_t * seqnos,
+                   uint64_t * scores,
+                   uint64_t * diffs,
+                   uint64_t * alignmentlengths,
+                   uint64_t longestdbsequence,
+                   std::vector<uint64_t> & dirbuffer) -> void;
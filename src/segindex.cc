@@ -0,0 +1,294 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include "segindex.h"
+#include "db.h"
+#include "zobrist.h"
+#include "utils/hashtable_size.h"
+#include "utils/nt_codec.h"
+#include <algorithm>  // std::min(), std::max(), std::fill()
+#include <atomic>
+#include <cassert>
+#include <cstddef>  // std::ptrdiff_t
+#include <cstdint>  // int64_t, uint64_t
+#include <cstdlib>  // std::abs()
+#include <iterator>  // std::next, std::prev
+#include <limits>
+#include <vector>
+
+
+constexpr uint64_t min_segment_length {8};  /* shorter segments are not selective */
+
+
+auto segindex_start(uint64_t const length,
+                    uint64_t const rank,
+                    uint64_t const segments) -> uint64_t
+{
+  return rank * length / segments;
+}
+
+
+auto segindex_bucket(struct segindex_bin_s const & bin,
+                     uint64_t const hash,
+                     uint64_t const rank) -> uint64_t
+{
+  /* mix the rank into the segment hash, keep the upper bits */
+  static constexpr uint64_t rank_salt {0xC2B2AE3D27D4EB4F};
+  static constexpr uint64_t multiplier {0xFF51AFD7ED558CCD};
+  const auto key = (hash ^ (rank * rank_salt)) * multiplier;
+  return bin.first_bucket + (key >> bin.bucket_shift);
+}
+
+
+auto segindex_unpack(uint64_t const seqno,
+                     std::vector<unsigned char> & sequence_v) -> uint64_t
+{
+  auto * sequence = db_getsequence(seqno);
+  const uint64_t length = db_getsequencelen(seqno);
+  sequence_v.resize(length);
+  for(auto pos = 0ULL; pos < length; ++pos) {
+    sequence_v[pos] = nt_extract(sequence, pos);
+  }
+  return length;
+}
+
+
+auto segindex_hash(std::vector<unsigned char> const & sequence_v,
+                   uint64_t const start,
+                   uint64_t const length) -> uint64_t
+{
+  /* independent of the position of the segment in the sequence */
+  uint64_t hash {0};
+  for(auto pos = 0U; pos < length; ++pos) {
+    hash ^= zobrist_value(pos, sequence_v[start + pos]);
+  }
+  return hash;
+}
+
+
+auto segindex_init(struct segindex_s & index,
+                   unsigned int const differences,
+                   uint64_t const amplicons) -> void
+{
+  static constexpr uint64_t no_bucket = std::numeric_limits<uint64_t>::max();
+  const uint64_t segments = differences + 1ULL;
+  index.differences = differences;
+
+  /* one bin per amplicon length, listing its amplicons */
+  index.bins_v = std::vector<struct segindex_bin_s>(db_getlongestsequence() + 1ULL);
+  for(auto seqno = 0ULL; seqno < amplicons; ++seqno) {
+    ++index.bins_v[db_getsequencelen(seqno)].size;
+  }
+  uint64_t members {0};
+  for(auto & bin : index.bins_v) {
+    bin.first_member = members;
+    bin.remaining.store(bin.size, std::memory_order_relaxed);
+    members += bin.size;
+  }
+  index.members_v.resize(amplicons);
+  {
+    std::vector<uint64_t> next_v(index.bins_v.size());
+    for(auto length = 0ULL; length < index.bins_v.size(); ++length) {
+      next_v[length] = index.bins_v[length].first_member;
+    }
+    for(auto seqno = 0ULL; seqno < amplicons; ++seqno) {
+      auto & next = next_v[db_getsequencelen(seqno)];
+      index.members_v[next] = static_cast<unsigned int>(seqno);
+      ++next;
+    }
+  }
+
+  /* buckets, sized for their amplicons, for bins with selective
+     segments */
+  uint64_t buckets {0};
+  for(auto length = 0ULL; length < index.bins_v.size(); ++length) {
+    auto & bin = index.bins_v[length];
+    if ((bin.size == 0) or (length / segments < min_segment_length)) {
+      continue;
+    }
+    const auto size = compute_hashtable_size(bin.size * segments);
+    bin.indexed = true;
+    bin.first_bucket = buckets;
+    bin.bucket_shift = std::numeric_limits<uint64_t>::digits;
+    for(auto i = size; i > 1; i >>= 1U) {
+      --bin.bucket_shift;
+    }
+    buckets += size;
+  }
+
+  /* hash all segments once, then count, then fill the buckets */
+  std::vector<uint64_t> buckets_v(amplicons * segments, no_bucket);
+  std::vector<unsigned char> sequence_v;
+  uint64_t entries {0};
+  for(auto seqno = 0ULL; seqno < amplicons; ++seqno) {
+    auto const & bin = index.bins_v[db_getsequencelen(seqno)];
+    if (not bin.indexed) {
+      continue;
+    }
+    const auto length = segindex_unpack(seqno, sequence_v);
+    for(auto rank = 0ULL; rank < segments; ++rank) {
+      const auto start = segindex_start(length, rank, segments);
+      const auto end = segindex_start(length, rank + 1, segments);
+      const auto hash = segindex_hash(sequence_v, start, end - start);
+      buckets_v[(seqno * segments) + rank] = segindex_bucket(bin, hash, rank);
+    }
+    entries += segments;
+  }
+
+  index.starts_v.assign(buckets + 1, 0);
+  for(auto const bucket : buckets_v) {
+    if (bucket != no_bucket) {
+      ++index.starts_v[bucket + 1];
+    }
+  }
+  for(auto bucket = 1ULL; bucket <= buckets; ++bucket) {
+    index.starts_v[bucket] += index.starts_v[bucket - 1];
+  }
+
+  std::vector<uint64_t> ends_v(index.starts_v.begin(), std::prev(index.starts_v.end()));
+  index.entries_v.resize(entries);
+  for(auto i = 0ULL; i < buckets_v.size(); ++i) {
+    if (buckets_v[i] == no_bucket) {
+      continue;
+    }
+    auto & end = ends_v[buckets_v[i]];
+    index.entries_v[end] = static_cast<unsigned int>(i / segments);
+    ++end;
+  }
+}
+
+
+auto segindex_exit(struct segindex_s & index) -> void
+{
+  // release memory
+  index.bins_v.clear();
+  index.bins_v.shrink_to_fit();
+  index.members_v.clear();
+  index.members_v.shrink_to_fit();
+  index.starts_v.clear();
+  index.starts_v.shrink_to_fit();
+  index.entries_v.clear();
+  index.entries_v.shrink_to_fit();
+}
+
+
+auto segindex_remove(struct segindex_s & index, uint64_t const seqno) -> void
+{
+  /* seqno is swarmed; its entries are skipped by lookups */
+  auto & bin = index.bins_v[db_getsequencelen(seqno)];
+  assert(bin.remaining > 0);
+  bin.remaining.fetch_sub(1, std::memory_order_relaxed);
+}
+
+
+auto segindex_lookup(struct segindex_s const & index,
+                     uint64_t const seqno,
+                     struct segindex_work_s & work,
+                     std::vector<uint64_t> & candidates) -> void
+{
+  /* append the amplicons that have a segment found in seqno at a
+     reachable position */
+  const auto differences = static_cast<int64_t>(index.differences);
+  const uint64_t segments = index.differences + 1ULL;
+  auto const & query_v = work.query_v;
+  const auto length = static_cast<int64_t>(segindex_unpack(seqno, work.query_v));
+  const auto longest = static_cast<int64_t>(index.bins_v.size()) - 1;
+  const auto shortest_target = std::max<int64_t>(0, length - differences);
+  const auto longest_target = std::min(longest, length + differences);
+
+  /* a new stamp for the amplicons and windows seen by this lookup */
+  ++work.lookups;
+  if (work.lookups == 0) {
+    std::fill(work.seen_v.begin(), work.seen_v.end(), 0U);
+    std::fill(work.hashed_v.begin(), work.hashed_v.end(), 0U);
+    work.lookups = 1;
+  }
+  work.seen_v.resize(index.members_v.size());
+
+  /* query windows are hashed on first use; segments of the visited
+     bins have lengths within [narrowest, widest] */
+  const auto narrowest = static_cast<uint64_t>(shortest_target) / segments;
+  const auto widest = (static_cast<uint64_t>(longest_target) + segments - 1) / segments;
+  const auto stride = static_cast<uint64_t>(length) + 1;
+  work.hashes_v.resize((widest - narrowest + 1) * stride);
+  work.hashed_v.resize(work.hashes_v.size());
+  auto window_hash = [&work, &query_v, narrowest, stride](uint64_t const position,
+                                                          uint64_t const width) -> uint64_t {
+    const auto window = ((width - narrowest) * stride) + position;
+    if (work.hashed_v[window] != work.lookups) {
+      work.hashes_v[window] = segindex_hash(query_v, position, width);
+      work.hashed_v[window] = work.lookups;
+    }
+    return work.hashes_v[window];
+  };
+
+  for(auto target_length = shortest_target; target_length <= longest_target; ++target_length) {
+    auto const & bin = index.bins_v[static_cast<uint64_t>(target_length)];
+    const auto remaining = bin.remaining.load(std::memory_order_relaxed);
+    if (remaining == 0) {
+      continue;
+    }
+
+    /* a shift s of the segment costs |s| indels before it and
+       |delta - s| after it */
+    const auto delta = length - target_length;
+    const auto slack = (differences - std::abs(delta)) / 2;
+    const auto lowest_shift = std::min<int64_t>(0, delta) - slack;
+    const auto highest_shift = std::max<int64_t>(0, delta) + slack;
+
+    /* the pool of that length, when probing would cost more */
+    const auto probes = segments * static_cast<uint64_t>(highest_shift - lowest_shift + 1);
+    if ((not bin.indexed) or (remaining <= probes)) {
+      candidates.insert(candidates.end(),
+                        std::next(index.members_v.cbegin(),
+                                  static_cast<std::ptrdiff_t>(bin.first_member)),
+                        std::next(index.members_v.cbegin(),
+                                  static_cast<std::ptrdiff_t>(bin.first_member + bin.size)));
+      continue;
+    }
+
+    for(auto rank = 0ULL; rank < segments; ++rank) {
+      const auto start = static_cast<int64_t>(
+          segindex_start(static_cast<uint64_t>(target_length), rank, segments));
+      const auto end = static_cast<int64_t>(
+          segindex_start(static_cast<uint64_t>(target_length), rank + 1, segments));
+
+      for(auto shift = lowest_shift; shift <= highest_shift; ++shift) {
+        const auto position = start + shift;
+        if ((position < 0) or (position + (end - start) > length)) {
+          continue;
+        }
+        const auto hash = window_hash(static_cast<uint64_t>(position),
+                                      static_cast<uint64_t>(end - start));
+        const auto bucket = segindex_bucket(bin, hash, rank);
+        for(auto entry = index.starts_v[bucket]; entry < index.starts_v[bucket + 1]; ++entry) {
+          const auto amp = index.entries_v[entry];
+          if (work.seen_v[amp] != work.lookups) {
+            work.seen_v[amp] = work.lookups;
+            candidates.push_back(amp);
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,89 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include <atomic>
+#include <cstdint>  // uint64_t
+#include <vector>
+
+
+/*
+  Pigeonhole seed index (d > 1): each amplicon is cut into d + 1
+  segments of (nearly) equal length. An alignment with at most d
+  differences leaves at least one segment of the target untouched,
+  and that segment appears verbatim in the query, shifted by the net
+  number of indels before it. Segments are hashed with the Zobrist
+  tables and keyed with the segment rank. The index is partitioned
+  into one bin per amplicon length, so a lookup only visits the bins
+  within d of the query length that still hold unswarmed amplicons.
+
+  A bin whose segments are too short to be selective has no buckets,
+  and a lookup returns all its amplicons, as does a lookup that would
+  probe a bin more often than it has amplicons (the pool of that
+  length). A lookup returns a superset of the amplicons within d
+  differences of the query (bucket collisions only add candidates),
+  each once, in no particular order, swarmed or not: filtering is
+  left to the caller. Lookups do not modify the index, and removals
+  only update the bin counts, so several threads can use the index
+  at the same time, each with its own work area.
+*/
+
+struct segindex_bin_s
+{
+  uint64_t first_bucket {0};
+  uint64_t first_member {0};  /* in members_v */
+  uint64_t size {0};  /* amplicons of that length */
+  std::atomic<uint64_t> remaining {0};  /* unswarmed amplicons of that length */
+  unsigned int bucket_shift {0};
+  bool indexed {false};  /* has buckets */
+};
+
+struct segindex_s
+{
+  unsigned int differences {0};
+  std::vector<struct segindex_bin_s> bins_v;  /* by amplicon length */
+  std::vector<unsigned int> members_v;  /* amplicon ids, by length, then id */
+  std::vector<uint64_t> starts_v;  /* first entry of each bucket, plus end */
+  std::vector<unsigned int> entries_v;  /* amplicon ids, by bucket */
+};
+
+struct segindex_work_s
+{
+  std::vector<unsigned char> query_v;  /* unpacked query */
+  std::vector<uint64_t> hashes_v;  /* of query windows, by length, then position */
+  std::vector<unsigned int> hashed_v;  /* by window, last lookup hashing it */
+  std::vector<unsigned int> seen_v;  /* by amplicon, last lookup finding it */
+  unsigned int lookups {0};
+};
+
+auto segindex_init(struct segindex_s & index,
+                   unsigned int differences,
+                   uint64_t amplicons) -> void;
+
+auto segindex_exit(struct segindex_s & index) -> void;
+
+auto segindex_remove(struct segindex_s & index, uint64_t seqno) -> void;
+
+auto segindex_lookup(struct segindex_s const & index,
+                     uint64_t seqno,
+                     struct segindex_work_s & work,
+                     std::vector<uint64_t> & candidates) -> void;
@@ -27,15 +27,16 @@
 #include "db.h"
 #include "derep.h"
 #include "utils/alignment_parameters.h"
-#include "utils/fatal.h"
 #include "utils/gcd.h"
 #include "utils/input_output.h"
 #include "utils/open_and_close_files.h"
 #include "utils/opt_boundary.h"
 #include "utils/opt_log.h"
 #include "utils/opt_no_cluster_breaking.h"
+#include "utils/opt_numa.h"
 #include "utils/opt_threads.h"
 #include "utils/seqinfo.h"
+#include "utils/threads.h"
 #include "utils/x86_cpu_features.h"
 #include "zobrist.h"
 #include <algorithm>  // std::min()
@@ -45,6 +46,7 @@
 #include <cstdint>  // int64_t
 #include <cstdio>  // FILE, fclose, stderr  // refactoring: replace with <fstream>
 #include <cstdlib>  // std::exit
+#include <cstring>  // std::strcmp
 #include <getopt.h>  // getopt_long, optarg, optind, opterr, struct
                      // option (no_argument, required_argument)
 #include <iterator>  // std::next
@@ -75,6 +77,9 @@ std::string opt_log;
 int64_t opt_boundary;
 bool opt_no_cluster_breaking {false};
 int64_t opt_threads;
+Numa_policy opt_numa {Numa_policy::local};
+
+ThreadRunner * thread_pool {nullptr};
 
 int64_t penalty_mismatch;
 int64_t penalty_gapextend;
@@ -83,10 +88,19 @@ int64_t penalty_gapopen;
 
 /* fine names and command line options */
 
-constexpr int n_options {26};
+/* options without a short form get values after 'z' */
+constexpr int compress_network_option {'z' + 1};
+constexpr int symmetric_links_option {'z' + 2};
+constexpr int lazy_clustering_option {'z' + 3};
+constexpr int merge_join_option {'z' + 4};
+constexpr int fastidious_index_option {'z' + 5};
+constexpr int multi_pass_option {'z' + 6};
+constexpr int numa_option {'z' + 7};
+constexpr int last_option {numa_option};
+constexpr int n_options {last_option - 'a' + 1};
 
 // refactoring: add option -q (no-cluster-breaking)
-const std::array<struct option, 25> long_options = {
+const std::array<struct option, n_options + 1> long_options = {
   { // struct option { name, has_arg, flag, val }
    {"append-abundance",      required_argument, nullptr, 'a' },
    {"boundary",              required_argument, nullptr, 'b' },
@@ -112,6 +126,13 @@ const std::array<struct option, 25> long_options = {
    {"disable-sse3",          no_argument,       nullptr, 'x' },
    {"bloom-bits",            required_argument, nullptr, 'y' },
    {"usearch-abundance",     no_argument,       nullptr, 'z' },
+   {"compress-network",      no_argument,       nullptr, compress_network_option },
+   {"symmetric-links",       no_argument,       nullptr, symmetric_links_option },
+   {"lazy-clustering",       no_argument,       nullptr, lazy_clustering_option },
+   {"merge-join",            no_argument,       nullptr, merge_join_option },
+   {"fastidious-index",      required_argument, nullptr, fastidious_index_option },
+   {"multi-pass",            no_argument,       nullptr, multi_pass_option },
+   {"numa",                  required_argument, nullptr, numa_option },
    {nullptr,                 0,                 nullptr, 0 }
   }
 };
@@ -150,12 +171,19 @@ const std::vector<std::string> args_usage_message
    "Clustering options:\n",
    " -d, --differences INTEGER           resolution (1)\n",
    " -n, --no-otu-breaking               never break clusters (not recommended!)\n",
+   "     --compress-network              compress the network (only when d = 1)\n",
+   "     --symmetric-links               probe each pair once (only when d = 1)\n",
+   "     --lazy-clustering               do not store the network (only when d = 1)\n",
+   "     --merge-join                    sort variants to find links (only when d = 1)\n",
+   "     --numa STRING                   local, interleave or off (local, only when d = 1)\n",
    "\n",
    "Fastidious options (only when d = 1):\n",
    " -b, --boundary INTEGER              min mass of large clusters (3)\n",
    " -c, --ceiling INTEGER               max memory in MB for Bloom filter (unlim.)\n",
    " -f, --fastidious                    link nearby low-abundance swarms\n",
-   " -y, --bloom-bits INTEGER            bits used per Bloom filter entry (16)\n",
+   " -y, --bloom-bits INTEGER|auto       bits used per Bloom filter entry (16)\n",
+   "     --fastidious-index STRING       bloom, exact, deletion or fuse (bloom)\n",
+   "     --multi-pass                    honour --ceiling with several passes\n",
    "\n",
    "Input/output options:\n",
    " -a, --append-abundance INTEGER      value to use when abundance is missing\n",
@@ -267,6 +295,7 @@ auto args_init(int argc, char **argv, struct Parameters & parameters) -> std::ar
 
   opt_boundary = parameters.opt_boundary;
   opt_threads = parameters.opt_threads;
+  opt_numa = parameters.opt_numa;
   opterr = 1;  // unused variable? get_opt option?
 
   int option_character {0};
@@ -282,10 +311,10 @@ auto args_init(int argc, char **argv, struct Parameters & parameters) -> std::ar
 
     /* check if any option is specified more than once */
 
-    if ((option_character >= 'a') and (option_character <= 'z'))
+    if ((option_character >= 'a') and (option_character <= last_option))
       {
         assert(option_character - 'a' >= 0);
-        assert(option_character <= std::numeric_limits<char>::max());
+        assert(option_character <= last_option);
         auto optindex = static_cast<unsigned int>(option_character - 'a');
         if (used_options[optindex])
           {
@@ -302,6 +331,10 @@ auto args_init(int argc, char **argv, struct Parameters & parameters) -> std::ar
               ++longoptindex;
             }
 
+            if (option_character > 'z') {
+              fatal(error_prefix, "Option --", long_options[longoptindex].name,
+                    " specified more than once.");
+            }
             fatal(error_prefix, "Option -", static_cast<char>(option_character),
                   " or --", long_options[longoptindex].name,
                   " specified more than once.");
@@ -427,7 +460,12 @@ auto args_init(int argc, char **argv, struct Parameters & parameters) -> std::ar
 
       case 'y':
         /* bloom-bits */
-        parameters.opt_bloom_bits = args_long(optarg, "-y or --bloom-bits");
+        if (std::strcmp(optarg, "auto") == 0) {
+          parameters.opt_bloom_auto = true;
+        }
+        else {
+          parameters.opt_bloom_bits = args_long(optarg, "-y or --bloom-bits");
+        }
         break;
 
       case 'z':
@@ -435,6 +473,69 @@ auto args_init(int argc, char **argv, struct Parameters & parameters) -> std::ar
         parameters.opt_usearch_abundance = true;
         break;
 
+      case compress_network_option:
+        /* compress-network */
+        parameters.opt_compress_network = true;
+        break;
+
+      case symmetric_links_option:
+        /* symmetric-links */
+        parameters.opt_symmetric_links = true;
+        break;
+
+      case lazy_clustering_option:
+        /* lazy-clustering */
+        parameters.opt_lazy_clustering = true;
+        break;
+
+      case merge_join_option:
+        /* merge-join */
+        parameters.opt_merge_join = true;
+        break;
+
+      case fastidious_index_option:
+        /* fastidious-index */
+        if (std::strcmp(optarg, "bloom") == 0) {
+          parameters.opt_fastidious_index = Fastidious_index::bloom;
+        }
+        else if (std::strcmp(optarg, "exact") == 0) {
+          parameters.opt_fastidious_index = Fastidious_index::exact;
+        }
+        else if (std::strcmp(optarg, "deletion") == 0) {
+          parameters.opt_fastidious_index = Fastidious_index::deletion;
+        }
+        else if (std::strcmp(optarg, "fuse") == 0) {
+          parameters.opt_fastidious_index = Fastidious_index::fuse;
+        }
+        else {
+          fatal(error_prefix, "Invalid argument for option --fastidious-index, "
+                "must be bloom, exact, deletion or fuse.");
+        }
+        break;
+
+      case multi_pass_option:
+        /* multi-pass */
+        parameters.opt_multi_pass = true;
+        break;
+
+      case numa_option:
+        /* numa */
+        if (std::strcmp(optarg, "local") == 0) {
+          parameters.opt_numa = Numa_policy::local;
+        }
+        else if (std::strcmp(optarg, "interleave") == 0) {
+          parameters.opt_numa = Numa_policy::interleave;
+        }
+        else if (std::strcmp(optarg, "off") == 0) {
+          parameters.opt_numa = Numa_policy::off;
+        }
+        else {
+          fatal(error_prefix, "Invalid argument for option --numa, "
+                "must be local, interleave or off.");
+        }
+        opt_numa = parameters.opt_numa;
+        break;
+
       default:
         show(header_message, parameters.logfile);
         show(args_usage_message, parameters.logfile);
@@ -492,6 +593,9 @@ auto args_check(const std::array<bool, n_options> &used_options,
   static constexpr unsigned int match_reward_index {12};
   static constexpr unsigned int mismatch_penalty_index {15};
   static constexpr unsigned int bloom_bits_index {24};
+  static constexpr unsigned int fastidious_index_index {fastidious_index_option - 'a'};
+  static constexpr unsigned int multi_pass_index {multi_pass_option - 'a'};
+  static constexpr unsigned int numa_index {numa_option - 'a'};
 
   if ((parameters.opt_threads < 1) or (parameters.opt_threads > max_threads))
     {
@@ -525,6 +629,20 @@ auto args_check(const std::array<bool, n_options> &used_options,
       if (used_options[bloom_bits_index]) {
         fatal(error_prefix, "Option -y or --bloom-bits specified without -f or --fastidious.");
       }
+      if (used_options[fastidious_index_index]) {
+        fatal(error_prefix, "Option --fastidious-index specified without -f or --fastidious.");
+      }
+    }
+
+  if (used_options[multi_pass_index] and (not used_options[ceiling_index])) {
+    fatal(error_prefix, "Option --multi-pass specified without -c or --ceiling.");
+  }
+
+  if ((parameters.opt_fastidious_index != Fastidious_index::bloom) and
+      (used_options[bloom_bits_index]))
+    {
+      fatal(error_prefix, "Option -y or --bloom-bits only applies to "
+            "--fastidious-index bloom.");
     }
 
   if (parameters.opt_differences < 2)
@@ -582,7 +700,11 @@ auto args_check(const std::array<bool, n_options> &used_options,
   if ((parameters.opt_bloom_bits < min_bits_per_entry) or
       (parameters.opt_bloom_bits > max_bits_per_entry)) {
     fatal(error_prefix, "Illegal number of Bloom filter bits specified with -y or "
-          "--bloom-bits, must be in the range 2 to 64.");
+          "--bloom-bits, must be in the range 2 to 64, or auto.");
+  }
+
+  if (parameters.opt_multi_pass and parameters.opt_bloom_auto) {
+    fatal(error_prefix, "Option --multi-pass requires a fixed -y or --bloom-bits value.");
   }
 
   if ((used_options[append_abundance_index]) and (parameters.opt_append_abundance < 1)) {
@@ -594,6 +716,26 @@ auto args_check(const std::array<bool, n_options> &used_options,
     fatal(error_prefix, "A network file can only written when d = 1.");
   }
 
+  if (parameters.opt_compress_network and (parameters.opt_differences != 1)) {
+    fatal(error_prefix, "Option --compress-network only works when d = 1.");
+  }
+
+  if (parameters.opt_symmetric_links and (parameters.opt_differences != 1)) {
+    fatal(error_prefix, "Option --symmetric-links only works when d = 1.");
+  }
+
+  if (parameters.opt_lazy_clustering and (parameters.opt_differences != 1)) {
+    fatal(error_prefix, "Option --lazy-clustering only works when d = 1.");
+  }
+
+  if (parameters.opt_merge_join and (parameters.opt_differences != 1)) {
+    fatal(error_prefix, "Option --merge-join only works when d = 1.");
+  }
+
+  if (used_options[numa_index] and (parameters.opt_differences != 1)) {
+    fatal(error_prefix, "Option --numa only works when d = 1.");
+  }
+
   if (parameters.opt_version) {
     show(header_message, parameters.logfile);
     std::exit(EXIT_SUCCESS);
@@ -631,6 +773,11 @@ auto main(int argc, char** argv) -> int
   show(header_message, parameters.logfile);
   args_show(parameters);
 
+  // worker threads, shared by all phases
+  assert(parameters.opt_threads <= std::numeric_limits<int>::max());
+  ThreadRunner threads(static_cast<int>(parameters.opt_threads));
+  thread_pool = &threads;
+
   // parse fasta input
   std::vector<char> data_v;  // refactoring: std::string fails? .data() -> const char *
   std::vector<struct seqinfo_s> seqindex_v;
@@ -662,4 +809,5 @@ auto main(int argc, char** argv) -> int
   zobrist_exit();
   db_free();
   close_files(parameters);
+  thread_pool = nullptr;
 }
@@ -51,6 +51,12 @@ constexpr unsigned int bloom_bits_default {16};
 
 /* common data */
 
+/* how light swarm microvariants are stored (fastidious) */
+enum struct Fastidious_index : unsigned char { bloom, exact, deletion, fuse };
+
+/* how the pages of large d = 1 tables are placed (see utils/first_touch.h) */
+enum struct Numa_policy : unsigned char { local, interleave, off };
+
 struct Parameters {
   int64_t opt_threads {1};
   int64_t opt_bloom_bits {bloom_bits_default};
@@ -84,6 +90,14 @@ struct Parameters {
   bool opt_usearch_abundance {false};
   bool opt_mothur {false};
   bool opt_no_cluster_breaking {false};
+  bool opt_compress_network {false};
+  bool opt_symmetric_links {false};
+  bool opt_lazy_clustering {false};
+  bool opt_merge_join {false};
+  bool opt_multi_pass {false};
+  bool opt_bloom_auto {false};
+  Fastidious_index opt_fastidious_index {Fastidious_index::bloom};
+  Numa_policy opt_numa {Numa_policy::local};
   std::string input_filename {dash_filename};
   std::string opt_network_file;
   std::string opt_internal_structure;
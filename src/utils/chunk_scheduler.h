@@ -0,0 +1,100 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include <algorithm>  // std::min(), std::max()
+#include <atomic>
+#include <cstdint>  // uint64_t
+
+
+/*
+  Lock-free distribution of an index range [0, end) among threads.
+
+  Large batches are taken with a single fetch_add while plenty of work
+  remains. Near the tail, batch sizes shrink in proportion to the
+  remaining work (guided scheduling), down to min_chunk, so that all
+  threads finish at roughly the same time.
+*/
+
+class ChunkScheduler
+{
+private:
+
+  std::atomic<uint64_t> next {0};
+  std::atomic<uint64_t> done {0};
+  uint64_t end {0};
+  uint64_t threads {1};
+  uint64_t min_chunk {1};
+  uint64_t max_chunk {1};
+
+public:
+
+  ChunkScheduler(uint64_t const length,
+                 uint64_t const thread_count,
+                 uint64_t const min_chunk_size,
+                 uint64_t const max_chunk_size) :
+    end {length},
+    threads {std::max<uint64_t>(thread_count, 1)},
+    min_chunk {std::max<uint64_t>(min_chunk_size, 1)},
+    max_chunk {std::max(max_chunk_size, min_chunk)} {}
+
+  ChunkScheduler(const ChunkScheduler&) = delete; // copy constructor
+  ChunkScheduler(ChunkScheduler&&) = delete; // move constructor
+  auto operator=(const ChunkScheduler&) -> ChunkScheduler& = delete; // copy assignment constructor
+  auto operator=(ChunkScheduler&&) -> ChunkScheduler& = delete; // move assignment constructor
+  ~ChunkScheduler() = default;
+
+  // claim the next batch, return false when the range is exhausted
+  auto get_chunk(uint64_t & first, uint64_t & count) -> bool {
+    auto current = next.load(std::memory_order_relaxed);
+
+    /* bulk phase: fixed-size batches, no retry loop */
+    if ((current < end) and (end - current > 2 * threads * max_chunk)) {
+      first = next.fetch_add(max_chunk, std::memory_order_relaxed);
+      if (first >= end) {
+        return false;
+      }
+      count = std::min(max_chunk, end - first);
+      return true;
+    }
+
+    /* tail phase: guided batches */
+    while (current < end) {
+      auto const remaining = end - current;
+      auto const guided = remaining / (2 * threads);
+      auto const chunk = std::min(remaining,
+                                  std::max(min_chunk, std::min(max_chunk, guided)));
+      if (next.compare_exchange_weak(current, current + chunk,
+                                     std::memory_order_relaxed)) {
+        first = current;
+        count = chunk;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // report completed work, return the total completed so far
+  auto add_done(uint64_t const count) -> uint64_t {
+    return done.fetch_add(count, std::memory_order_relaxed) + count;
+  }
+};
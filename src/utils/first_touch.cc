@@ -0,0 +1,125 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include "../swarm.h"
+#include "first_touch.h"
+#include "opt_numa.h"
+#include "opt_threads.h"
+#include "threads.h"
+#include <algorithm>  // std::min
+#include <array>
+#include <cstddef>  // std::ptrdiff_t
+#include <cstdint>  // uint64_t, uintptr_t
+#include <cstring>  // std::memset
+#include <iterator>  // std::next
+#ifdef __linux__
+#include <sys/syscall.h>  // SYS_mbind, SYS_get_mempolicy
+#include <unistd.h>  // syscall(), sysconf()
+#endif
+
+
+constexpr uint64_t parallel_fill_min {1ULL << 24};  // 16 MB, smaller areas are filled serially
+constexpr uint64_t fill_page_size {4096};  // slices start on page boundaries
+
+static unsigned char * fill_data {nullptr};
+static uint64_t fill_size {0};
+static unsigned char fill_value {0};
+static uint64_t fill_threads {1};
+
+
+auto fill_thread(int64_t nth_thread) -> void
+{
+  /* each thread fills one contiguous slice of whole pages */
+  const auto pages = (fill_size + fill_page_size - 1) / fill_page_size;
+  const auto thread = static_cast<uint64_t>(nth_thread);
+  const auto first = std::min(fill_size, pages * thread / fill_threads * fill_page_size);
+  const auto last = std::min(fill_size, pages * (thread + 1) / fill_threads * fill_page_size);
+  std::memset(std::next(fill_data, static_cast<std::ptrdiff_t>(first)),
+              fill_value, last - first);
+}
+
+
+auto interleave_pages(void * data, uint64_t const size) -> void
+{
+  /* ask the kernel to place the pages of this (untouched) memory area
+     round-robin on all allowed memory nodes; this is a hint only, and
+     failures are ignored */
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_get_mempolicy)
+  static constexpr int mpol_interleave {3};  // from numaif.h, to avoid linking with libnuma
+  static constexpr unsigned long mpol_f_mems_allowed {4};
+  static constexpr unsigned long max_nodes {1024};
+  static constexpr unsigned long bits_per_long {8 * sizeof(unsigned long)};
+  std::array<unsigned long, max_nodes / bits_per_long> nodemask {{}};
+
+  if (syscall(SYS_get_mempolicy, nullptr, nodemask.data(), max_nodes,
+              nullptr, mpol_f_mems_allowed) != 0) {
+    return;
+  }
+
+  const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const auto address = reinterpret_cast<uintptr_t>(data);
+  const auto start = (address + page_size - 1) & ~(page_size - 1);
+  const auto end = (address + size) & ~(page_size - 1);
+  if (end <= start) {
+    return;
+  }
+  syscall(SYS_mbind, start, end - start, mpol_interleave,
+          nodemask.data(), max_nodes, 0);
+#else
+  static_cast<void>(data);
+  static_cast<void>(size);
+#endif
+}
+
+
+auto parallel_fill(void * data, uint64_t const size, unsigned char const value) -> void
+{
+  /* fill a memory area with value, using all threads for large areas */
+  fill_data = static_cast<unsigned char *>(data);
+  fill_size = size;
+  fill_value = value;
+  fill_threads = 1;
+  if ((opt_numa != Numa_policy::off) and (size >= parallel_fill_min)) {
+    fill_threads = static_cast<uint64_t>(opt_threads);
+  }
+
+  if (fill_threads == 1) {
+    fill_thread(0);
+  }
+  else {
+    thread_pool->run(fill_thread);
+  }
+
+  fill_data = nullptr;
+}
+
+
+auto first_touch_fill(void * data, uint64_t const size, unsigned char const value) -> void
+{
+  /* initialize a newly allocated memory area, whose pages have not
+     been touched yet, according to the --numa policy */
+  if ((opt_numa == Numa_policy::interleave) and (size >= parallel_fill_min)) {
+    interleave_pages(data, size);
+  }
+  parallel_fill(data, size, value);
+}
@@ -0,0 +1,39 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include <cstdint>  // uint64_t
+
+
+/*
+  Large d = 1 tables (hash table, Bloom filters) are allocated without
+  initialization, and their pages are first touched by
+  first_touch_fill(), using all threads. On a NUMA machine, each page
+  is then placed on the memory node of the thread that touched it
+  (--numa local), or pages are interleaved over all nodes
+  (--numa interleave), instead of all landing on the node of the main
+  thread.
+*/
+
+auto first_touch_fill(void * data, uint64_t size, unsigned char value) -> void;
+
+auto parallel_fill(void * data, uint64_t size, unsigned char value) -> void;
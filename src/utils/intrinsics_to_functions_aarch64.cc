@@ -205,6 +205,16 @@ auto v_xor8(uint8x16_t lhs, uint8x16_t rhs) -> uint8x16_t {
   return veorq_u8(lhs, rhs);
 }
 
+auto v_eq16(uint16x8_t lhs, uint16x8_t rhs) -> uint16x8_t {
+  // set all bits of equal elements, clear the others
+  return vceqq_u16(lhs, rhs);
+}
+
+auto v_eq8(uint8x16_t lhs, uint8x16_t rhs) -> uint8x16_t {
+  // set all bits of equal elements, clear the others
+  return vceqq_u8(lhs, rhs);
+}
+
 auto v_shift_left16(uint16x8_t vector) -> uint16x8_t {
   // shift vector to the left by n bytes, pad with zeros
   static constexpr auto n_bytes = 7;
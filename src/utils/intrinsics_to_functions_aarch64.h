@@ -93,6 +93,10 @@ auto v_xor16(uint16x8_t lhs, uint16x8_t rhs) -> uint16x8_t;
 
 auto v_xor8(uint8x16_t lhs, uint8x16_t rhs) -> uint8x16_t;
 
+auto v_eq16(uint16x8_t lhs, uint16x8_t rhs) -> uint16x8_t;
+
+auto v_eq8(uint8x16_t lhs, uint8x16_t rhs) -> uint8x16_t;
+
 auto v_shift_left16(uint16x8_t vector) -> uint16x8_t;
 
 auto v_shift_left8(uint8x16_t vector) -> uint8x16_t;
@@ -283,6 +283,18 @@ auto v_xor8(v_u8_t lhs, v_u8_t rhs) -> v_u8_t {
   return vec_xor(lhs, rhs);
 }
 
+auto v_eq16(v_u16_t lhs, v_u16_t rhs) -> v_u16_t {
+  // set all bits of equal elements, clear the others
+  // (vec_cmpeq -> vector bool short)
+  return reinterpret_cast<v_u16_t>(vec_cmpeq(lhs, rhs));
+}
+
+auto v_eq8(v_u8_t lhs, v_u8_t rhs) -> v_u8_t {
+  // set all bits of equal elements, clear the others
+  // (vec_cmpeq -> vector bool char)
+  return reinterpret_cast<v_u8_t>(vec_cmpeq(lhs, rhs));
+}
+
 auto v_shift_left16(v_u16_t vector) -> v_u16_t {
   // shift vector to the left by n bytes, pad with zeros
   // n: 4-bit unsigned literal (in the range 0–15)
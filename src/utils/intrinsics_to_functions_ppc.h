@@ -112,6 +112,10 @@ auto v_xor16(v_u16_t lhs, v_u16_t rhs) -> v_u16_t;
 
 auto v_xor8(v_u8_t lhs, v_u8_t rhs) -> v_u8_t;
 
+auto v_eq16(v_u16_t lhs, v_u16_t rhs) -> v_u16_t;
+
+auto v_eq8(v_u8_t lhs, v_u8_t rhs) -> v_u8_t;
+
 auto v_shift_left16(v_u16_t vector) -> v_u16_t;
 
 auto v_shift_left8(v_u8_t vector) -> v_u8_t;
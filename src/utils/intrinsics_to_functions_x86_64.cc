@@ -160,6 +160,16 @@ auto v_xor8(__m128i lhs, __m128i rhs) -> __m128i {
   return _mm_xor_si128(lhs, rhs);
 }
 
+auto v_eq16(__m128i lhs, __m128i rhs) -> __m128i {
+  // set all bits of equal elements, clear the others
+  return _mm_cmpeq_epi16(lhs, rhs);
+}
+
+auto v_eq8(__m128i lhs, __m128i rhs) -> __m128i {
+  // set all bits of equal elements, clear the others
+  return _mm_cmpeq_epi8(lhs, rhs);
+}
+
 auto v_shift_left16(__m128i vector) -> __m128i {
   // shift vector to the left by n bytes, pad with zeros
   static constexpr auto n_bytes = 2;
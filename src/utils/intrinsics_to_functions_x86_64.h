@@ -86,6 +86,10 @@ auto v_xor16(__m128i lhs, __m128i rhs) -> __m128i;
 
 auto v_xor8(__m128i lhs, __m128i rhs) -> __m128i;
 
+auto v_eq16(__m128i lhs, __m128i rhs) -> __m128i;
+
+auto v_eq8(__m128i lhs, __m128i rhs) -> __m128i;
+
 auto v_shift_left16(__m128i vector) -> __m128i;
 
 auto v_shift_left8(__m128i vector) -> __m128i;
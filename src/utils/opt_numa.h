@@ -21,13 +21,7 @@
     PO Box 1080 Blindern, NO-0316 Oslo, Norway
 */
 
-#include <cstdint>  // uint64_t
+enum struct Numa_policy : unsigned char;  // see swarm.h
 
 
-struct thread_info_s
-{
-  uint64_t seed;
-  uint64_t listlen;
-  uint64_t * amplist;
-  uint64_t * difflist;
-};
+extern Numa_policy opt_numa;
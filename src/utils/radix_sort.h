@@ -0,0 +1,77 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include <array>
+#include <cstdint>  // uint64_t
+#include <vector>
+
+
+/*
+  Stable LSD radix sort of a vector on the lowest key_bits bits of a
+  64-bit key, one byte at a time. Passes where all keys share the same
+  byte are skipped. The buffer is used as scratch space and has the
+  same size on return.
+*/
+
+template <typename T, typename Key>
+auto radix_sort(std::vector<T> & values,
+                std::vector<T> & buffer,
+                Key key,
+                unsigned int const key_bits = 64) -> void
+{
+  static constexpr unsigned int bits_per_pass {8};
+  static constexpr unsigned int buckets {1U << bits_per_pass};
+  static constexpr uint64_t digit_mask {buckets - 1};
+  const auto passes = (key_bits + bits_per_pass - 1) / bits_per_pass;
+
+  buffer.resize(values.size());
+  if (values.empty()) {
+    return;
+  }
+  std::array<uint64_t, buckets> offsets {{}};
+
+  for(auto pass = 0U; pass < passes; ++pass)
+    {
+      const auto shift = pass * bits_per_pass;
+      offsets.fill(0);
+      for(auto const & value : values) {
+        ++offsets[(key(value) >> shift) & digit_mask];
+      }
+
+      /* skip pass if all values fall in the same bucket */
+      if (offsets[(key(values.front()) >> shift) & digit_mask] == values.size()) {
+        continue;
+      }
+
+      auto start = 0ULL;
+      for(auto & offset : offsets) {
+        const auto count = offset;
+        offset = start;
+        start += count;
+      }
+      for(auto const & value : values) {
+        buffer[offsets[(key(value) >> shift) & digit_mask]++] = value;
+      }
+      values.swap(buffer);
+    }
+}
@@ -39,6 +39,11 @@ struct Search_data
   std::vector<BYTE> hearray_v;
   std::vector<uint64_t> dir_array_v;
 
+  /* query symbols and last rows, when aligning pairs */
+  std::vector<BYTE> qsymbols_v;
+  std::vector<BYTE> qlast_v;
+  std::vector<BYTE> lastrows_v;
+
   uint64_t target_count = 0;
   uint64_t target_index = 0;
 };
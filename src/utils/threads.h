@@ -21,54 +21,96 @@
     PO Box 1080 Blindern, NO-0316 Oslo, Norway
 */
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
 #include <pthread.h>  // refactoring: C++11 replace with std::thread
+#include <sched.h>  // sched_yield
 #include "fatal.h"
 
 
+/*
+  Pool of worker threads, created once and shared by all phases.
+
+  run(function) calls function once per thread, with thread ids 0 to
+  thread_count - 1, and returns when all calls are done. The calling
+  thread is thread 0. Work is usually distributed within a call with
+  a ChunkScheduler (parallel-for over an index range).
+
+  Between calls, idle threads spin for a while, yielding the CPU,
+  before they park on a condition variable: a parallel region
+  following closely after another one does not pay the wake-up
+  latency, and waking up parked threads takes a single broadcast.
+*/
+
 class ThreadRunner
 {
 private:
 
-  pthread_attr_t attr {};
+  static constexpr auto spin_limit = 4096U;  /* yields before parking */
 
   struct thread_s
   {
+    ThreadRunner * pool;
     int64_t thread_id;
-    void (*fun)(int64_t thread_id);
     pthread_t pthread;
-    pthread_mutex_t workmutex;
-    pthread_cond_t workcond;
-    int64_t work; /* 1: work available, 0: wait, -1: quit */
   };
 
-  std::vector<struct thread_s> thread_array;
+  pthread_attr_t attr {};
+  pthread_mutex_t mutex {};
+  pthread_cond_t work_cond {};  /* new call or quit, for parked threads */
+  pthread_cond_t done_cond {};  /* all threads done, for the caller */
+  std::vector<struct thread_s> thread_array;  /* threads 1 and up */
+  void (*fun)(int64_t thread_id) {nullptr};
+  std::atomic<uint64_t> generation {0};  /* calls so far */
+  std::atomic<uint64_t> pending {0};  /* threads busy with this call */
+  std::atomic<bool> quit {false};
+
+  auto wait_for_work(uint64_t & seen) -> bool
+  {
+    /* until a call newer than seen, or quit */
+    for(auto i = 0U; (i < spin_limit) and
+          (generation.load(std::memory_order_acquire) == seen); ++i) {
+      sched_yield();
+    }
+
+    pthread_mutex_lock(&mutex);
+    while ((generation.load(std::memory_order_acquire) == seen) and
+           (not quit.load(std::memory_order_acquire))) {
+      pthread_cond_wait(&work_cond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (quit.load(std::memory_order_acquire)) {
+      return false;
+    }
+    seen = generation.load(std::memory_order_acquire);
+    return true;
+  }
+
+  auto work_done() -> void
+  {
+    /* the last thread done wakes up the caller */
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      pthread_mutex_lock(&mutex);
+      pthread_cond_signal(&done_cond);
+      pthread_mutex_unlock(&mutex);
+    }
+  }
 
   static auto worker(void * void_ptr) -> void *
   {
     auto * tip = static_cast<struct thread_s *>(void_ptr);
-
-    pthread_mutex_lock(&tip->workmutex);  // refactoring: prefer mutex_lockguard (RAII)
+    auto & pool = *tip->pool;
+    uint64_t seen {0};
 
     /* loop until signalled to quit */
-    while (tip->work >= 0)
+    while (pool.wait_for_work(seen))
       {
-        /* wait for work available */
-        if (tip->work == 0) {
-          pthread_cond_wait(&tip->workcond, &tip->workmutex);
-        }
-
-        if (tip->work > 0)
-          {
-            (*tip->fun)(tip->thread_id);
-            tip->work = 0;
-            pthread_cond_signal(&tip->workcond);
-          }
+        (*pool.fun)(tip->thread_id);
+        pool.work_done();
       }
 
-    pthread_mutex_unlock(&tip->workmutex);
-
     return nullptr;
   }
 
@@ -77,29 +119,30 @@ public:
 
   // refactoring: heaptrack detects a memory leak of 640 bytes for
   // each thread created by this member function. Backtrace:
-  // ThreadRunner::ThreadRunner(int, void (*)(long))
+  // ThreadRunner::ThreadRunner(int)
   //   __pthread_create_2_1 in libc.so.6
   //   allocate_stack in libc.so.6
   //   __GI__dl_allocate_tls in ld-linux-x86-64.so.2
   //   allocate_dtv in ld-linux-x86-64.so.2
   //   calloc in ld-linux-x86-64.so.2
-  ThreadRunner(int thread_count, void (*function_ptr)(int64_t nth_thread))
+  explicit ThreadRunner(int thread_count)
   {
-
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&work_cond, nullptr);
+    pthread_cond_init(&done_cond, nullptr);
 
-    /* allocate memory for thread data */
-    thread_array.resize(static_cast<uint64_t>(thread_count));
+    /* allocate memory for thread data, the caller is thread 0 */
+    if (thread_count > 1) {
+      thread_array.resize(static_cast<uint64_t>(thread_count - 1));
+    }
 
-    /* init and create worker threads */
-    auto counter = 0LL;
+    /* create worker threads */
+    auto counter = 1LL;
     for(auto& tip: thread_array) {
+        tip.pool = this;
         tip.thread_id = counter;
-        tip.work = 0;
-        tip.fun = function_ptr;
-        pthread_mutex_init(&tip.workmutex, nullptr);
-        pthread_cond_init(&tip.workcond, nullptr);
         if (pthread_create(&tip.pthread,
                            &attr,
                            worker,
@@ -113,27 +156,22 @@ public:
 
   ~ThreadRunner()
   {
-    /* ask threads to quit */
-    /* sleep until they have quit */
-    /* destroy threads */
-    /* finish and clean up worker threads */
+    /* tell workers to quit */
+    pthread_mutex_lock(&mutex);
+    quit.store(true, std::memory_order_release);
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&mutex);
 
+    /* wait for them to quit */
     for(auto& tip: thread_array) {
-        /* tell worker to quit */
-        pthread_mutex_lock(&tip.workmutex);
-        tip.work = -1;
-        pthread_cond_signal(&tip.workcond);
-        pthread_mutex_unlock(&tip.workmutex);
-
-        /* wait for worker to quit */
         if (pthread_join(tip.pthread, nullptr) != 0) {
           fatal(error_prefix, "Cannot join thread.");
         }
-
-        pthread_cond_destroy(&tip.workcond);
-        pthread_mutex_destroy(&tip.workmutex);
     }
 
+    pthread_cond_destroy(&done_cond);
+    pthread_cond_destroy(&work_cond);
+    pthread_mutex_destroy(&mutex);
     pthread_attr_destroy(&attr);
   }
 
@@ -142,22 +180,35 @@ public:
   auto operator=(const ThreadRunner&) -> ThreadRunner& = delete; // copy assignment constructor
   auto operator=(ThreadRunner&&) -> ThreadRunner& = delete; // move assignment constructor
 
-  auto run() -> void {
-    /* wake up threads */
-    for(auto& tip: thread_array) {
-        pthread_mutex_lock(&tip.workmutex);
-        tip.work = 1;
-        pthread_cond_signal(&tip.workcond);
-        pthread_mutex_unlock(&tip.workmutex);
+  auto run(void (*function_ptr)(int64_t nth_thread)) -> void {
+    if (thread_array.empty()) {
+      (*function_ptr)(0);
+      return;
     }
 
+    /* wake up threads */
+    fun = function_ptr;
+    pending.store(thread_array.size(), std::memory_order_relaxed);
+    pthread_mutex_lock(&mutex);
+    generation.fetch_add(1, std::memory_order_release);
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&mutex);
+
+    (*function_ptr)(0);
+
     /* wait for threads to finish their work */
-    for(auto& tip: thread_array) {
-        pthread_mutex_lock(&tip.workmutex);
-        while (tip.work > 0) {
-          pthread_cond_wait(&tip.workcond, &tip.workmutex);
-        }
-        pthread_mutex_unlock(&tip.workmutex);
+    for(auto i = 0U; (i < spin_limit) and
+          (pending.load(std::memory_order_acquire) != 0); ++i) {
+      sched_yield();
+    }
+    pthread_mutex_lock(&mutex);
+    while (pending.load(std::memory_order_acquire) != 0) {
+      pthread_cond_wait(&done_cond, &mutex);
     }
+    pthread_mutex_unlock(&mutex);
   }
 };
+
+
+/* created in main(), shared by all phases */
+extern ThreadRunner * thread_pool;
@@ -0,0 +1,93 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include <atomic>
+#include <cstdint>  // uint64_t
+#include <utility>  // std::swap
+#include <vector>
+
+
+/*
+  Lock-free union-find (disjoint sets) on amplicon ids.
+
+  Roots are always linked under the smaller of the two roots, so the
+  representative of a set is its smallest amplicon id, whatever the
+  order in which threads perform the unions. find() uses path
+  halving; both find() and unite() can be called concurrently.
+*/
+
+class UnionFind
+{
+private:
+
+  std::vector<std::atomic<unsigned int>> parent;
+
+public:
+
+  explicit UnionFind(uint64_t const size) : parent(size) {
+    auto counter = 0U;
+    for(auto & node : parent) {
+      node.store(counter, std::memory_order_relaxed);
+      ++counter;
+    }
+  }
+
+  UnionFind(const UnionFind&) = delete; // copy constructor
+  UnionFind(UnionFind&&) = delete; // move constructor
+  auto operator=(const UnionFind&) -> UnionFind& = delete; // copy assignment constructor
+  auto operator=(UnionFind&&) -> UnionFind& = delete; // move assignment constructor
+  ~UnionFind() = default;
+
+  auto find(unsigned int node) -> unsigned int {
+    auto up = parent[node].load(std::memory_order_relaxed);
+    while (up != node) {
+      auto const grand_parent = parent[up].load(std::memory_order_relaxed);
+      // path halving: failure means another thread shortened the path
+      parent[node].compare_exchange_weak(up, grand_parent,
+                                         std::memory_order_relaxed);
+      node = grand_parent;
+      up = parent[node].load(std::memory_order_relaxed);
+    }
+    return node;
+  }
+
+  auto unite(unsigned int lhs, unsigned int rhs) -> void {
+    while (true) {
+      lhs = find(lhs);
+      rhs = find(rhs);
+      if (lhs == rhs) {
+        return;
+      }
+      if (lhs < rhs) {
+        std::swap(lhs, rhs);
+      }
+      // link the larger root under the smaller one, retry if lhs
+      // stopped being a root in the meantime
+      auto expected = lhs;
+      if (parent[lhs].compare_exchange_strong(expected, rhs,
+                                              std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+};
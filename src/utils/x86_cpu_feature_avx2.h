@@ -21,14 +21,7 @@
     PO Box 1080 Blindern, NO-0316 Oslo, Norway
 */
 
-#include <cstdint>  // int64_t, uint64_t
+#include <cstdint>  // int64_t
 
 
-struct queryinfo
-{
-  uint64_t qno;
-  int64_t len;
-  char * seq;
-};
-
-extern struct queryinfo query;
+extern int64_t avx2_present;
@@ -23,6 +23,7 @@
 
 #include "../swarm.h"
 #include "fatal.h"
+#include "x86_cpu_feature_avx2.h"
 #include "x86_cpu_feature_popcnt.h"
 #include "x86_cpu_feature_sse41.h"
 #include "x86_cpu_feature_ssse3.h"
@@ -35,6 +36,7 @@
 int64_t ssse3_present {0};
 int64_t sse41_present {0};
 int64_t popcnt_present {0};
+int64_t avx2_present {0};
 
 #ifdef __x86_64__
 
@@ -51,6 +53,17 @@ auto cpuid(unsigned int leaf_level,
                         : "a" (leaf_level), "c" (sublevel));
 }
 
+auto xgetbv(unsigned int xcr) -> uint64_t
+{
+  /* extended control register, only if the OS set CPUID.1:ECX.OSXSAVE */
+  unsigned int eax {0};
+  unsigned int edx {0};
+  __asm__ __volatile__ ("xgetbv"
+                        : "=a" (eax), "=d" (edx)
+                        : "c" (xcr));
+  return (static_cast<uint64_t>(edx) << 32U) | eax;
+}
+
 auto cpu_features_detect(struct Parameters & parameters) -> void
 {
   static constexpr auto uint8_max = std::numeric_limits<uint8_t>::max();
@@ -63,6 +76,7 @@ auto cpu_features_detect(struct Parameters & parameters) -> void
   static constexpr unsigned int bit_sse41 {19};
   static constexpr unsigned int bit_sse42 {20};
   static constexpr unsigned int bit_popcnt {23};
+  static constexpr unsigned int bit_osxsave {27};
   static constexpr unsigned int bit_avx {28};
   static constexpr unsigned int bit_avx2 {5};
 
@@ -93,10 +107,17 @@ auto cpu_features_detect(struct Parameters & parameters) -> void
   popcnt_present = parameters.popcnt_present;
   parameters.avx_present    = (ecx >> bit_avx) & 1U;
 
-  if (maxlevel >= post_pentium)
+  /* AVX2 instructions also need the OS to save the XMM and YMM
+     registers (XCR0 bits 1 and 2), or they fault */
+  static constexpr uint64_t xcr0_sse_avx {0x6};
+  const bool ymm_enabled = (((ecx >> bit_osxsave) & 1U) != 0) and
+    ((xgetbv(0) & xcr0_sse_avx) == xcr0_sse_avx);
+
+  if ((maxlevel >= post_pentium) and ymm_enabled)
     {
       cpuid(post_pentium, 0, eax, ebx, ecx, edx);  // leaf 7
       parameters.avx2_present   = (ebx >> bit_avx2) & 1U;
+      avx2_present = parameters.avx2_present;
     }
 }
 
@@ -117,6 +138,7 @@ auto cpu_features_test(struct Parameters & parameters) -> void {
       popcnt_present = 0;
       parameters.avx_present = 0;
       parameters.avx2_present = 0;
+      avx2_present = 0;
     }
 }
 
@@ -24,6 +24,8 @@
 #include "utils/nt_codec.h"
 #include "variants.h"
 #include "zobrist.h"
+#include <algorithm>  // std::min
+#include <array>
 #include <cstdint>  // uint64_t
 #include <cstring>  // std::memcpy
 #include <iterator>  // std::next
@@ -75,6 +77,30 @@ inline auto seq_identical(char * seq_a,
 }
 
 
+/* position, type and base of a variant, packed in 32 bits */
+constexpr unsigned int variant_type_shift {2};
+constexpr unsigned int variant_pos_shift {4};
+constexpr unsigned int variant_field_mask {3};
+
+
+auto pack_variant(struct var_s const & var) -> unsigned int
+{
+  return (var.pos << variant_pos_shift) |
+    (static_cast<unsigned int>(var.type) << variant_type_shift) | var.base;
+}
+
+
+auto unpack_variant(uint64_t const hash, unsigned int const packed) -> struct var_s
+{
+  struct var_s var {};
+  var.hash = hash;
+  var.pos = packed >> variant_pos_shift;
+  var.type = static_cast<Variant_type>((packed >> variant_type_shift) & variant_field_mask);
+  var.base = static_cast<unsigned char>(packed & variant_field_mask);
+  return var;
+}
+
+
 auto generate_variant_sequence(char * seed_sequence,
                                unsigned int seed_seqlen,
                                struct var_s & var,
@@ -181,6 +207,54 @@ inline auto add_variant(uint64_t hash,
 }
 
 
+template <typename Action>
+inline auto for_each_deletion(char * sequence,
+                              unsigned int const start,
+                              unsigned int const length,
+                              Action action) -> void
+{
+  /* single-deletion variants of the segment starting at start, one
+     per homopolymer run: action(hash, offset) receives the hash of
+     the variant (positions relative to start) and the offset of the
+     first nucleotide of the deleted run */
+  uint64_t hash = 0;
+  if (start == 0) {
+    hash = zobrist_hash_delete_first(reinterpret_cast<unsigned char *>(sequence), length);
+  }
+  else {
+    for(auto offset = 1U; offset < length; ++offset) {
+      hash ^= zobrist_value(offset - 1, nt_extract(sequence, start + offset));
+    }
+  }
+  action(hash, 0U);
+  auto previous_base = nt_extract(sequence, start);
+  for(auto offset = 1U; offset < length; ++offset)
+    {
+      const auto current_base = nt_extract(sequence, start + offset);
+      if (current_base == previous_base) {
+        continue;
+      }
+      hash ^= zobrist_value(offset - 1, previous_base) ^ zobrist_value(offset - 1, current_base);
+      action(hash, offset);
+      previous_base = current_base;
+    }
+}
+
+
+inline auto add_deletion_variants(char * sequence,
+                                  unsigned int const seqlen,
+                                  std::vector<struct var_s>& variant_list,
+                                  unsigned int & variant_count) -> void
+{
+  for_each_deletion(sequence, 0, seqlen,
+                    [&variant_list, &variant_count](uint64_t const hash,
+                                                    unsigned int const offset) -> void {
+                      add_variant(hash, Variant_type::deletion, offset, 0,
+                                  variant_list, variant_count);
+                    });
+}
+
+
 auto generate_variants(char * sequence,
                        unsigned int seqlen,
                        uint64_t hash,
@@ -207,19 +281,7 @@ auto generate_variants(char * sequence,
 
   /* deletions */
 
-  hash = zobrist_hash_delete_first(reinterpret_cast<unsigned char *>(sequence), seqlen);
-  add_variant(hash, Variant_type::deletion, 0, 0, variant_list, variant_count);
-  auto previous_base = nt_extract(sequence, 0);
-  for(auto offset = 1U; offset < seqlen; ++offset)
-    {
-      const auto current_base = nt_extract(sequence, offset);
-      if (current_base == previous_base) {
-        continue;
-      }
-      hash ^= zobrist_value(offset - 1, previous_base) ^ zobrist_value(offset - 1, current_base);
-      add_variant(hash, Variant_type::deletion, offset, 0, variant_list, variant_count);
-      previous_base = current_base;
-    }
+  add_deletion_variants(sequence, seqlen, variant_list, variant_count);
 
   /* insertions */
 
@@ -247,3 +309,151 @@ auto generate_variants(char * sequence,
 
   return variant_count;
 }
+
+
+auto count_variants(char * sequence,
+                    unsigned int seqlen) -> unsigned int
+{
+  /* number of microvariants produced by generate_variants(): 3
+     substitutions and 3 insertions per position, 4 insertions before
+     the first position, and one deletion per homopolymer run */
+  static constexpr auto per_position = 6U;
+  static constexpr auto offset = 4U;
+  auto runs = (seqlen == 0) ? 0U : 1U;
+  for(auto position = 1U; position < seqlen; ++position) {
+    if (nt_extract(sequence, position) != nt_extract(sequence, position - 1)) {
+      ++runs;
+    }
+  }
+  return (per_position * seqlen) + runs + offset;
+}
+
+
+auto generate_half_variants(char * sequence,
+                            unsigned int seqlen,
+                            uint64_t hash,
+                            std::vector<struct var_s>& variant_list) -> unsigned int
+{
+  /* each pair of microvariants is reached from one side only: a
+     substitution from the sequence with the lower nucleotide code at
+     that position, an indel from the longer sequence (deletion) */
+  auto variant_count = 0U;
+
+  /* substitutions towards a higher nucleotide code */
+
+  for(auto offset = 0U; offset < seqlen; ++offset)
+    {
+      const auto current_base = nt_extract(sequence, offset);
+      const auto hash1 = hash ^ zobrist_value(offset, current_base);
+      for(auto base = static_cast<unsigned char>(current_base + 1); base < 4; ++base) {
+        const auto hash2 = hash1 ^ zobrist_value(offset, base);
+        add_variant(hash2, Variant_type::substitution, offset, base,
+                    variant_list, variant_count);
+      }
+    }
+
+  /* deletions */
+
+  add_deletion_variants(sequence, seqlen, variant_list, variant_count);
+
+  return variant_count;
+}
+
+
+auto generate_deletion_neighbourhood(char * sequence,
+                                     unsigned int start,
+                                     unsigned int length,
+                                     std::vector<uint64_t>& hashes) -> unsigned int
+{
+  /* hash of the segment starting at start (positions relative to
+     start), followed by the hashes of its distinct single-deletion
+     variants: at most length + 1 values */
+  auto hash_count = 0U;
+
+  uint64_t hash = 0;
+  for(auto offset = 0U; offset < length; ++offset) {
+    hash ^= zobrist_value(offset, nt_extract(sequence, start + offset));
+  }
+  hashes[hash_count] = hash;
+  ++hash_count;
+
+  if (length == 0) {
+    return hash_count;
+  }
+
+  /* deletions, one per homopolymer run */
+
+  for_each_deletion(sequence, start, length,
+                    [&hashes, &hash_count](uint64_t const deletion_hash,
+                                           unsigned int const /* offset */) -> void {
+                      hashes[hash_count] = deletion_hash;
+                      ++hash_count;
+                    });
+
+  return hash_count;
+}
+
+
+auto check_two_differences(char * seq1,
+                           unsigned int seqlen1,
+                           char * seq2,
+                           unsigned int seqlen2) -> bool
+{
+  /* true if the edit distance between the two sequences is at most
+     two (banded dynamic programming, diagonals -2 to +2) */
+  static constexpr unsigned int max_distance {2};
+  static constexpr unsigned int band {(2 * max_distance) + 1};
+  static constexpr unsigned int too_far {max_distance + 1};
+
+  const auto length_difference = (seqlen1 > seqlen2) ?
+    seqlen1 - seqlen2 : seqlen2 - seqlen1;
+  if (length_difference > max_distance) {
+    return false;
+  }
+
+  /* cell d of row i holds the distance between the first i
+     nucleotides of seq1 and the first i + d - 2 nucleotides of seq2 */
+  std::array<unsigned int, band> previous {};
+  std::array<unsigned int, band> current {};
+
+  for(auto d = 0U; d < band; ++d) {
+    previous[d] = ((d >= max_distance) and (d - max_distance <= seqlen2)) ?
+      d - max_distance : too_far;
+  }
+
+  for(auto i = 1U; i <= seqlen1; ++i)
+    {
+      auto row_minimum = too_far;
+      for(auto d = 0U; d < band; ++d)
+        {
+          auto distance = too_far;
+          if ((i + d < max_distance) or (i + d - max_distance > seqlen2)) {
+            current[d] = distance;  /* outside the matrix */
+            continue;
+          }
+          const auto j = i + d - max_distance;
+          if (j == 0) {
+            distance = std::min(i, too_far);
+          }
+          else {
+            const auto mismatch =
+              (nt_extract(seq1, i - 1) != nt_extract(seq2, j - 1)) ? 1U : 0U;
+            distance = std::min(distance, previous[d] + mismatch);
+            if (d + 1 < band) {
+              distance = std::min(distance, previous[d + 1] + 1);
+            }
+            if (d > 0) {
+              distance = std::min(distance, current[d - 1] + 1);
+            }
+          }
+          current[d] = distance;
+          row_minimum = std::min(row_minimum, distance);
+        }
+      if (row_minimum > max_distance) {
+        return false;
+      }
+      previous.swap(current);
+    }
+
+  return previous[seqlen2 + max_distance - seqlen1] <= max_distance;
+}
@@ -37,6 +37,10 @@ struct var_s
   unsigned short dummy; /* for alignment padding only */
 };
 
+auto pack_variant(struct var_s const & var) -> unsigned int;
+
+auto unpack_variant(uint64_t hash, unsigned int packed) -> struct var_s;
+
 auto generate_variant_sequence(char * seed_sequence,
                                unsigned int seed_seqlen,
                                struct var_s & var,
@@ -53,3 +57,21 @@ auto generate_variants(char * sequence,
                        unsigned int seqlen,
                        uint64_t hash,
                        std::vector<struct var_s>& variant_list) -> unsigned int;
+
+auto count_variants(char * sequence,
+                    unsigned int seqlen) -> unsigned int;
+
+auto generate_half_variants(char * sequence,
+                            unsigned int seqlen,
+                            uint64_t hash,
+                            std::vector<struct var_s>& variant_list) -> unsigned int;
+
+auto generate_deletion_neighbourhood(char * sequence,
+                                     unsigned int start,
+                                     unsigned int length,
+                                     std::vector<uint64_t>& hashes) -> unsigned int;
+
+auto check_two_differences(char * seq1,
+                           unsigned int seqlen1,
+                           char * seq2,
+                           unsigned int seqlen2) -> bool;
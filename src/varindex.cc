@@ -0,0 +1,115 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include "varindex.h"
+#include "utils/hashtable_size.h"
+#include <atomic>
+#include <cstdint>  // uint64_t
+#include <limits>
+#include <vector>
+
+
+constexpr auto empty_slot = std::numeric_limits<unsigned int>::max();
+
+
+auto varindex_init(uint64_t const entries,
+                   struct varindex_s & index) -> struct varindex_s *
+{
+  /* entries is an upper bound of the number of insertions */
+  const auto size = compute_hashtable_size(entries);
+  index.mask = size - 1;
+  std::vector<struct varindex_entry_s> entries_v(size);
+  index.entries_v.swap(entries_v);
+  for(auto & entry : index.entries_v) {
+    entry.amp.store(empty_slot, std::memory_order_relaxed);
+  }
+  return &index;
+}
+
+
+auto varindex_exit(struct varindex_s & index) -> void
+{
+  // release memory
+  index.entries_v.clear();
+  index.entries_v.shrink_to_fit();
+}
+
+
+auto varindex_size(struct varindex_s const * index) -> uint64_t
+{
+  /* in bytes */
+  return index->entries_v.size() * sizeof(struct varindex_entry_s);
+}
+
+
+auto varindex_getindex(struct varindex_s const * index, uint64_t const hash) -> uint64_t
+{
+  // Shift bits right to get independence from the simple Bloom filter hash
+  static constexpr auto divider = 32U;  // drop the first 32 bits
+  return (hash >> divider) & index->mask;
+}
+
+
+auto varindex_getnextindex(struct varindex_s const * index, uint64_t const position) -> uint64_t
+{
+  return (position + 1) & index->mask;
+}
+
+
+auto varindex_is_occupied(struct varindex_s const * index, uint64_t const position) -> bool
+{
+  return index->entries_v[position].amp.load(std::memory_order_relaxed) != empty_slot;
+}
+
+
+auto varindex_get(struct varindex_s const * index,
+                  uint64_t const position) -> struct varindex_entry_s const &
+{
+  return index->entries_v[position];
+}
+
+
+auto varindex_fingerprint(uint64_t const hash) -> unsigned int
+{
+  static constexpr auto lower_half = 0xFFFFFFFFULL;
+  return static_cast<unsigned int>(hash & lower_half);
+}
+
+
+auto varindex_insert(struct varindex_s * index, uint64_t const hash,
+                     unsigned int const amp, unsigned int const variant) -> void
+{
+  /* claim the first empty slot */
+  auto position = varindex_getindex(index, hash);
+  while (true)
+    {
+      auto & entry = index->entries_v[position];
+      auto expected = empty_slot;
+      if (entry.amp.compare_exchange_strong(expected, amp, std::memory_order_relaxed)) {
+        entry.fingerprint = varindex_fingerprint(hash);
+        entry.variant = variant;
+        return;
+      }
+      position = varindex_getnextindex(index, position);
+    }
+}
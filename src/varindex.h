@@ -0,0 +1,72 @@
+/*
+    SWARM
+
+    Copyright (C) 2012-2024 Torbjorn Rognes and Frederic Mahe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Contact: Torbjorn Rognes <torognes@ifi.uio.no>,
+    Department of Informatics, University of Oslo,
+    PO Box 1080 Blindern, NO-0316 Oslo, Norway
+*/
+
+#include <atomic>
+#include <cstdint>  // uint64_t
+#include <vector>
+
+
+/*
+  Exact index of light amplicon microvariants (fastidious): an open
+  addressing hash table with linear probing, mapping the hash of a
+  microvariant to the light amplicon it comes from and to the packed
+  description of the variant (see pack_variant()). The upper half of
+  the hash selects the slot, the lower half is kept as a fingerprint,
+  and matches must be verified. Several entries can share the same
+  hash. Slots are claimed with a CAS on the amplicon id, so threads
+  can insert concurrently. Lookups are only made once all insertions
+  are done.
+*/
+
+struct varindex_entry_s
+{
+  unsigned int fingerprint {0};
+  std::atomic<unsigned int> amp {0};
+  unsigned int variant {0};
+};
+
+struct varindex_s
+{
+  uint64_t mask = 0;
+  std::vector<struct varindex_entry_s> entries_v;
+};
+
+auto varindex_init(uint64_t entries,
+                   struct varindex_s & index) -> struct varindex_s *;
+
+auto varindex_exit(struct varindex_s & index) -> void;
+
+auto varindex_size(struct varindex_s const * index) -> uint64_t;
+
+auto varindex_insert(struct varindex_s * index, uint64_t hash,
+                     unsigned int amp, unsigned int variant) -> void;
+
+auto varindex_getindex(struct varindex_s const * index, uint64_t hash) -> uint64_t;
+
+auto varindex_getnextindex(struct varindex_s const * index, uint64_t position) -> uint64_t;
+
+auto varindex_is_occupied(struct varindex_s const * index, uint64_t position) -> bool;
+
+auto varindex_get(struct varindex_s const * index, uint64_t position) -> struct varindex_entry_s const &;
+
+auto varindex_fingerprint(uint64_t hash) -> unsigned int;